@@ -0,0 +1,432 @@
+// Benchmarks of the polynomial kernels and of whole runs of `poly`.
+//
+// Usage: bench [poly] [name [shape vars degree terms]]
+//
+// Runs the benchmarks of the table below, or those whose name is `name`, or a
+// single benchmark with the given workload. `poly` is the binary to time whole
+// runs of, `build/poly` by default. Every benchmark runs in a process of its
+// own, and reports a line of JSON:
+//
+//   {"bench": "mul", "shape": "sparse", "vars": 4, "degree": 10, "terms": 300,
+//    "iters": 52, "ns_op": 3812345, "allocs_op": 12.0, "nodes_op": 90210.0,
+//    "peak_rss_kb": 14380}
+//
+// `allocs_op` counts calls to `malloc`, `calloc` and `realloc`, and `nodes_op`
+// the `TermNode`s and other objects taken from pools, per operation. An
+// operation of `lookup` is a lookup of each of `terms` variables, and one of
+// `parse` a run of `poly` on a file of `terms` statements, whose allocations
+// are not counted.
+#define _POSIX_C_SOURCE 200809L // clock_gettime, fork
+#include "asgn.h"
+#include "pool.h"
+#include "rel.h"
+#include "sym.h"
+#include "term.h"
+#include "util.h"
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/resource.h>
+#include <sys/wait.h>
+#include <time.h>
+#include <unistd.h>
+
+// Benchmarks run for at least this long, and at least `MIN_ITERS` times.
+#define MIN_NS 200000000L
+#define MIN_ITERS 3
+
+typedef enum Shape { DENSE, SPARSE } Shape;
+
+// A workload: polynomials in `vars` variables of total degree up to `degree`.
+// Dense ones have every such monomial, and sparse ones `terms` random ones.
+typedef struct Spec {
+	const char *bench;
+	Shape shape;
+	int vars, degree, terms;
+} Spec;
+
+static const Spec SPECS[] = {
+	{"add", SPARSE, 4, 20, 10000},
+	{"add", DENSE, 3, 30, 0},
+	{"mul", SPARSE, 4, 10, 300},
+	{"mul", DENSE, 3, 10, 0},
+	{"pow", SPARSE, 3, 3, 6},
+	{"pow", DENSE, 2, 2, 0},
+	{"dup", SPARSE, 6, 20, 100000},
+	{"rel", SPARSE, 4, 20, 10000},
+	{"lookup", SPARSE, 1, 1, 10000},
+	{"parse", SPARSE, 4, 6, 20000},
+};
+
+static const char *SHAPES[] = {"dense", "sparse"};
+
+// Counters of allocations, incremented by the wrappers below. The benchmark
+// binary is linked with `--wrap` for each of the wrapped functions.
+static long nallocs, nnodes;
+
+void *__real_malloc(size_t size);
+void *__real_calloc(size_t n, size_t size);
+void *__real_realloc(void *p, size_t size);
+void *__real_pool_alloc(Pool *p);
+
+void *__wrap_malloc(size_t size)
+{
+	++nallocs;
+	return __real_malloc(size);
+}
+
+void *__wrap_calloc(size_t n, size_t size)
+{
+	++nallocs;
+	return __real_calloc(n, size);
+}
+
+void *__wrap_realloc(void *p, size_t size)
+{
+	++nallocs;
+	return __real_realloc(p, size);
+}
+
+void *__wrap_pool_alloc(Pool *p)
+{
+	++nnodes;
+	return __real_pool_alloc(p);
+}
+
+static long now(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1000000000L + ts.tv_nsec;
+}
+
+// A fixed generator, so that workloads are the same across versions.
+static uint64_t rng = 88172645463325252ULL;
+
+static long rnd(long n)
+{
+	rng ^= rng << 13;
+	rng ^= rng >> 7;
+	rng ^= rng << 17;
+	return rng % n;
+}
+
+static int var_sym(int i)
+{
+	char name[] = {'a' + i, '\0'};
+	return intern(name);
+}
+
+// Return `c` times the monomial of exponents `exps`.
+static TermNode *monomial(long c, const int *exps, int vars)
+{
+	TermNode *t = icoeff_term(c);
+	for (int i = 0; i < vars; ++i) {
+		if (exps[i]) {
+			TermNode *x = icoeff_term(1);
+			x->u.vars = var_term(var_sym(i), exps[i]);
+			mul_poly(&t, x);
+		}
+	}
+	return t;
+}
+
+// Return the sum of the `n` polynomials of `ps`, adding them pairwise so that
+// large workloads are generated quickly.
+static TermNode *sum(TermNode **ps, int n)
+{
+	if (n == 1) {
+		return ps[0];
+	}
+	TermNode *p = sum(ps, n / 2);
+	add_poly(&p, sum(ps + n / 2, n - n / 2));
+	return p;
+}
+
+// Append the monomials of degree up to `left` in the variables from `i` on to
+// `ps`, and return the new end of `ps`.
+static TermNode **gen_dense(TermNode **ps, int *exps, int i, int vars,
+			    int left)
+{
+	if (i == vars) {
+		*ps++ = monomial(1 + rnd(9), exps, vars);
+		return ps;
+	}
+	for (exps[i] = 0; exps[i] <= left; ++exps[i]) {
+		ps = gen_dense(ps, exps, i + 1, vars, left - exps[i]);
+	}
+	exps[i] = 0;
+	return ps;
+}
+
+// Return the number of monomials of degree up to `degree` in `vars` variables.
+static long count_dense(int vars, int degree)
+{
+	long n = 1;
+	for (int i = 1; i <= vars; ++i) {
+		n = n * (degree + i) / i;
+	}
+	return n;
+}
+
+// Return a polynomial of the shape of `s`.
+static TermNode *gen_poly(const Spec *s)
+{
+	int *exps = calloc(s->vars, sizeof *exps);
+	long n = s->shape == DENSE ? count_dense(s->vars, s->degree) : s->terms;
+	TermNode **ps = malloc(n * sizeof *ps);
+	if (s->shape == DENSE) {
+		gen_dense(ps, exps, 0, s->vars, s->degree);
+	} else {
+		for (int k = 0; k < n; ++k) {
+			int left = rnd(s->degree + 1);
+			for (int i = 0; i < s->vars; ++i) {
+				exps[i] = 0;
+			}
+			while (left--) {
+				++exps[rnd(s->vars)];
+			}
+			long c = 1 + rnd(9);
+			ps[k] = monomial(rnd(2) ? c : -c, exps, s->vars);
+		}
+	}
+	TermNode *p = sum(ps, n);
+	free(ps);
+	free(exps);
+	return p;
+}
+
+static int nterms(const TermNode *p)
+{
+	int n = 0;
+	for (; p; p = p->next) {
+		++n;
+	}
+	return n;
+}
+
+// State of a benchmark, set up before it is timed.
+static struct {
+	TermNode *a, *b;
+	Env env;
+	int *syms;
+	Arena arena;
+} st;
+
+// Allocations made by the operations timed so far.
+static long op_allocs, op_nodes;
+
+// Run one operation of `s`, and return the nanoseconds it took.
+static long run_op(const Spec *s)
+{
+	TermNode *a = NULL, *b = NULL;
+	long t = 0;
+	if (strcmp(s->bench, "lookup") && strcmp(s->bench, "dup")) {
+		a = poly_dup(st.a);
+		b = poly_dup(st.b);
+	}
+	long n0 = nallocs, m0 = nnodes;
+	long start = now();
+	if (!strcmp(s->bench, "add")) {
+		add_poly(&a, b);
+	} else if (!strcmp(s->bench, "mul")) {
+		mul_poly(&a, b);
+	} else if (!strcmp(s->bench, "pow")) {
+		free_poly(b);
+		pow_poly(&a, icoeff_term(s->degree + 4));
+	} else if (!strcmp(s->bench, "dup")) {
+		a = poly_dup(st.a);
+	} else if (!strcmp(s->bench, "rel")) {
+		RelNode *r = rnode(GE, a, b);
+		norm_rel(r);
+		t = now() - start;
+		free_rel(r);
+		arena_reset(&st.arena);
+		a = NULL;
+	} else if (!strcmp(s->bench, "lookup")) {
+		// Lookups are too quick to time one by one.
+		for (int i = 0; i < s->terms; ++i) {
+			lookup(st.syms[i], &st.env);
+		}
+	}
+	if (!t) {
+		t = now() - start;
+	}
+	// Neither copying the operands nor releasing the result is part of the
+	// operation.
+	op_allocs += nallocs - n0;
+	op_nodes += nnodes - m0;
+	free_poly(a);
+	return t;
+}
+
+// Time a whole run of `poly` on a generated file, and return its peak RSS.
+static long run_poly(const char *poly, const char *path, long *ns)
+{
+	long start = now();
+	pid_t pid = fork();
+	if (!pid) {
+		freopen("/dev/null", "w", stdout);
+		execl(poly, poly, "-q", path, (char *)NULL);
+		_exit(127);
+	}
+	int status;
+	waitpid(pid, &status, 0);
+	*ns = now() - start;
+	if (!WIFEXITED(status) || WEXITSTATUS(status)) {
+		fprintf(stderr, "bench: %s failed\n", poly);
+		exit(EXIT_FAILURE);
+	}
+	// Every run is of the same file, so the peak of any is that of each.
+	struct rusage ru;
+	getrusage(RUSAGE_CHILDREN, &ru);
+	return ru.ru_maxrss;
+}
+
+// Write `p` in the input syntax to `f`.
+static void write_poly(FILE *f, const TermNode *p)
+{
+	for (; p; p = p->next) {
+		fprintf(f, "%ld", p->hd.ival);
+		for (const TermNode *v = p->u.vars; v; v = v->next) {
+			fprintf(f, " %s^%ld", sym_name(v->hd.sym), v->u.pow);
+		}
+		if (p->next) {
+			fprintf(f, " + ");
+		}
+	}
+}
+
+// Generate a file of `s->terms` statements: assignments of polynomials of the
+// shape of `s`, and sums and products of them.
+static void gen_file(const Spec *s, const char *path)
+{
+	FILE *f = fopen(path, "w");
+	Spec small = *s;
+	small.terms = 8;
+	for (int i = 0; i < s->terms; ++i) {
+		TermNode *p = gen_poly(&small);
+		if (i % 4 == 0) {
+			fprintf(f, "'v%d := ", i);
+			write_poly(f, p);
+		} else if (i % 4 == 1) {
+			fprintf(f, "'v%d * (", i - 1);
+			write_poly(f, p);
+			fprintf(f, ")");
+		} else {
+			write_poly(f, p);
+			fprintf(f, " >= 'v%d", i - i % 4);
+		}
+		fprintf(f, "\n");
+		free_poly(p);
+	}
+	fclose(f);
+}
+
+static void bench(const Spec *s, const char *poly)
+{
+	Pool terms;
+	pool_init(&terms, sizeof(TermNode));
+	term_pool = &terms;
+	stmt_arena = &st.arena;
+	stmt_out = stdout;
+	stmt_err = stderr;
+
+	long iters = 0, total = 0, rss;
+	int size = 0;
+	if (!strcmp(s->bench, "parse")) {
+		char path[] = "/tmp/bench-XXXXXX";
+		close(mkstemp(path));
+		gen_file(s, path);
+		size = s->terms;
+		for (; total < MIN_NS || iters < MIN_ITERS; ++iters) {
+			long ns;
+			rss = run_poly(poly, path, &ns);
+			total += ns;
+		}
+		unlink(path);
+	} else {
+		if (!strcmp(s->bench, "lookup")) {
+			st.syms = malloc(s->terms * sizeof *st.syms);
+			for (int i = 0; i < s->terms; ++i) {
+				char name[16];
+				snprintf(name, sizeof name, "v%d", i);
+				st.syms[i] = intern(name);
+				TermNode *p = icoeff_term(i);
+				set_var(st.syms[i], p, &st.env);
+				free_poly(p);
+			}
+			for (int i = s->terms - 1; i > 0; --i) {
+				int j = rnd(i + 1), tmp = st.syms[i];
+				st.syms[i] = st.syms[j];
+				st.syms[j] = tmp;
+			}
+			st.a = icoeff_term(0);
+			size = s->terms;
+		} else {
+			st.a = gen_poly(s);
+			size = nterms(st.a);
+		}
+		st.b = gen_poly(s);
+		for (; total < MIN_NS || iters < MIN_ITERS; ++iters) {
+			total += run_op(s);
+		}
+		struct rusage ru;
+		getrusage(RUSAGE_SELF, &ru);
+		rss = ru.ru_maxrss;
+	}
+	printf("{\"bench\": \"%s\", \"shape\": \"%s\", \"vars\": %d, "
+	       "\"degree\": %d, \"terms\": %d, \"iters\": %ld, "
+	       "\"ns_op\": %ld, \"allocs_op\": %.1f, \"nodes_op\": %.1f, "
+	       "\"peak_rss_kb\": %ld}\n",
+	       s->bench, SHAPES[s->shape], s->vars, s->degree, size, iters,
+	       total / iters, (double)op_allocs / iters,
+	       (double)op_nodes / iters,
+	       rss);
+}
+
+// Run `s` in a process of its own, so that its peak RSS is its own.
+static void run(const Spec *s, const char *poly)
+{
+	fflush(stdout);
+	pid_t pid = fork();
+	if (!pid) {
+		bench(s, poly);
+		fflush(stdout);
+		_exit(0);
+	}
+	int status;
+	waitpid(pid, &status, 0);
+	if (!WIFEXITED(status) || WEXITSTATUS(status)) {
+		fprintf(stderr, "bench: %s failed\n", s->bench);
+	}
+}
+
+int main(int argc, char *argv[])
+{
+	const char *prog = argv[0], *poly = "build/poly";
+	if (argc > 1 && strchr(argv[1], '/')) {
+		poly = *++argv;
+		--argc;
+	}
+	if (argc == 6) {
+		Spec s = {argv[1], !strcmp(argv[2], "sparse"), atoi(argv[3]),
+			  atoi(argv[4]), atoi(argv[5])};
+		run(&s, poly);
+		return 0;
+	}
+	if (argc != 1 && argc != 2) {
+		fprintf(stderr,
+			"Usage: %s [poly] [name [shape vars degree terms]]\n",
+			prog);
+		return EXIT_FAILURE;
+	}
+	for (size_t i = 0; i < sizeof SPECS / sizeof *SPECS; ++i) {
+		if (argc == 1 || !strcmp(argv[1], SPECS[i].bench)) {
+			run(&SPECS[i], poly);
+		}
+	}
+	return 0;
+}
@@ -1,40 +1,117 @@
 #include "asgn.h"
 #include "term.h"
+#include <pthread.h>
 #include <stdbool.h>
 #include <stdlib.h>
-#include <string.h>
 
-// Sets variable `name` to `poly` in `*env`.
-bool set_var(char *name, struct TermNode *poly, EnvFrame **env)
+#define SLOTS_INIT 64
+
+static pthread_mutex_t terms_lock = PTHREAD_MUTEX_INITIALIZER;
+
+// Symbols are consecutive small integers, which a multiplication by an odd
+// constant spreads over distinct slots.
+static unsigned long hash(int sym) { return sym * 2654435769UL; }
+
+// Return the slot holding `sym`, or the empty slot to insert it to.
+static struct EnvSlot *probe(int sym, const Env *env)
+{
+	unsigned long mask = env->nslots - 1;
+	unsigned long i = hash(sym) & mask;
+	while (env->slots[i].sym >= 0 && env->slots[i].sym != sym) {
+		i = (i + 1) & mask;
+	}
+	return &env->slots[i];
+}
+
+static void rehash(Env *env, int nslots)
 {
-	if (lookup(name, *env)) { // `name` is already defined in `*env`.
+	struct EnvSlot *old = env->slots;
+	int nold = env->nslots;
+	env->slots = malloc(nslots * sizeof *env->slots);
+	env->nslots = nslots;
+	for (int i = 0; i < nslots; ++i) {
+		env->slots[i] = (struct EnvSlot){-1, NULL};
+	}
+	for (int i = 0; i < nold; ++i) {
+		if (old[i].sym >= 0) {
+			*probe(old[i].sym, env) = old[i];
+		}
+	}
+	free(old);
+}
+
+// Return the slot of `sym`, adding an unassigned one if there is none.
+static struct EnvSlot *add_slot(int sym, Env *env)
+{
+	if (!env->nslots) {
+		rehash(env, SLOTS_INIT);
+		pool_init(&env->terms, sizeof(TermNode));
+	}
+	struct EnvSlot *slot = probe(sym, env);
+	if (slot->sym < 0) {
+		slot->sym = sym;
+		if (2 * ++env->len > env->nslots) {
+			rehash(env, 2 * env->nslots);
+			slot = probe(sym, env);
+		}
+	}
+	return slot;
+}
+
+// Add `sym` to `env` unassigned, unless it is already there.
+void declare_var(int sym, Env *env) { add_slot(sym, env); }
+
+// Sets variable `sym` to a copy of `poly` in `env`, unless `sym` is already
+// defined.
+// Variables declared beforehand are assigned without modifying the table, and
+// concurrent assignments take turns to allocate from `env->terms`.
+bool set_var(int sym, const struct TermNode *poly, Env *env)
+{
+	struct EnvSlot *slot = add_slot(sym, env);
+	if (slot->poly) { // `sym` is already defined in `env`.
 		return false;
 	}
-	EnvFrame *fr = malloc(sizeof *fr);
-	*fr = (EnvFrame){name, poly, *env};
-	*env = fr;
+	pthread_mutex_lock(&terms_lock);
+	Pool *pool = term_pool;
+	term_pool = &env->terms;
+	slot->poly = poly_dup(poly);
+	term_pool = pool;
+	pthread_mutex_unlock(&terms_lock);
 	return true;
 }
 
-// Returns a `TermNode *` assigned to `name` if it exists, `NULL` otherwise.
-struct TermNode *lookup(const char *name, const EnvFrame *env)
+// Sets variable `sym` to `poly` in `env`, unless `sym` is already defined.
+// `poly` must be allocated from `env->terms`, which is ready once `sym` is
+// declared, and is owned by `env` once set.
+bool put_var(int sym, struct TermNode *poly, Env *env)
 {
-	for (const EnvFrame *fr = env; fr; fr = fr->next) {
-		if (strcmp(name, fr->name) == 0) {
-			return fr->poly;
-		}
+	struct EnvSlot *slot = add_slot(sym, env);
+	if (slot->poly) { // `sym` is already defined in `env`.
+		return false;
+	}
+	slot->poly = poly;
+	return true;
+}
+
+// Returns a `TermNode *` assigned to `sym` if it exists, `NULL` otherwise.
+struct TermNode *lookup(int sym, const Env *env)
+{
+	if (!env->nslots) {
+		return NULL;
 	}
-	return NULL;
+	return probe(sym, env)->poly;
 }
 
 // Release `env`.
-void free_env(EnvFrame *env)
+void free_env(Env *env)
 {
-	if (!env) {
-		return;
+	Pool *pool = term_pool;
+	term_pool = &env->terms;
+	for (int i = 0; i < env->nslots; ++i) {
+		free_poly(env->slots[i].poly);
 	}
-	free(env->name);
-	free_poly(env->poly);
-	free_env(env->next);
-	free(env);
+	term_pool = pool;
+	free_pool(&env->terms);
+	free(env->slots);
+	*env = (Env){0};
 }
@@ -1,21 +1,41 @@
 #ifndef ASGN_H
 #define ASGN_H
+#include "pool.h"
 #include <stdbool.h>
 
 struct TermNode;
-typedef struct EnvFrame {
-	char *name;
-	struct TermNode *poly;
-	struct EnvFrame *next;
-} EnvFrame;
+// Variables assigned so far, in an open-addressing hash table keyed by symbol.
+// An empty slot holds -1 as its symbol, and the table is kept at most half
+// full. The polynomials are owned by the environment and allocated from
+// `terms`, as they outlive the statements defining them. A variable may also be
+// declared ahead of its assignment, with a `NULL` polynomial; `len` counts the
+// declared variables as well.
+// A zero-initialized `Env` is an empty environment.
+typedef struct Env {
+	struct EnvSlot {
+		int sym;
+		struct TermNode *poly;
+	} *slots;
+	int len, nslots;
+	Pool terms;
+} Env;
 
-// Sets variable `name` to `poly` in `*env`.
-bool set_var(char *name, struct TermNode *poly, EnvFrame **env);
+// Add `sym` to `env` unassigned, unless it is already there.
+void declare_var(int sym, Env *env);
 
-// Returns a `TermNode *` assigned to `name` if it exists, `NULL` otherwise.
-struct TermNode *lookup(const char *name, const EnvFrame *env);
+// Sets variable `sym` to a copy of `poly` in `env`, unless `sym` is already
+// defined.
+bool set_var(int sym, const struct TermNode *poly, Env *env);
+
+// Sets variable `sym` to `poly` in `env`, unless `sym` is already defined.
+// `poly` must be allocated from `env->terms`, which is ready once `sym` is
+// declared, and is owned by `env` once set.
+bool put_var(int sym, struct TermNode *poly, Env *env);
+
+// Returns a `TermNode *` assigned to `sym` if it exists, `NULL` otherwise.
+struct TermNode *lookup(int sym, const Env *env);
 
 // Release `env`.
-void free_env(EnvFrame *env);
+void free_env(Env *env);
 
 #endif /* ifndef ASGN_H */
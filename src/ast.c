@@ -1,291 +1,592 @@
 #include "ast.h"
 #include "asgn.h"
+#include "bigint.h"
+#include "cache.h"
+#include "code.h"
+#include "out.h"
+#include "pool.h"
 #include "rel.h"
+#include "solve.h"
+#include "sym.h"
 #include "term.h"
+#include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 
+#define SLOTS_INIT 64
+
 // Allocate and initialize a `ASGN_NODE` type node.
 ASTNode *asgn_node(ASTNode *left, ASTNode *right)
 {
-	ASTNode *node = malloc(sizeof *node);
+	ASTNode *node = arena_alloc(stmt_arena, sizeof *node);
 	*node = (ASTNode){ASGN_NODE, .u.asgndat = {left, right}};
 	return node;
 }
 
-// Allocate and initialize a `REL_NODE` type node.
-ASTNode *rel_node(Rel rel, ASTNode *left, ASTNode *right)
+// Hash-consed nodes in an open-addressing hash table keyed by their contents,
+// kept at most half full. An empty slot holds `NULL`.
+// Children are hash-consed before their parents, so nodes are equal only if
+// their children are identical.
+// Nodes are allocated from `pool`, and collected by `collect_nodes` once the
+// table has doubled since the last collection, which left `live` nodes. `stamp`
+// numbers the walks over the nodes, marking each node visited with it.
+static struct {
+	ASTNode **slots;
+	int len, nslots;
+	int live;
+	Pool pool;
+	unsigned long stamp;
+} dag;
+
+// Nodes are not collected before there are this many.
+#define COLLECT_MIN (1 << 14)
+
+bool memoize = true;
+bool stream_terms;
+
+static unsigned long mix(unsigned long h, unsigned long v)
 {
-	ASTNode *node = malloc(sizeof *node);
-	*node = (ASTNode){REL_NODE, .u.reldat = {rel, left, right}};
-	return node;
+	return (h ^ v) * 1099511628211UL;
+}
+
+static unsigned long node_hash(const ASTNode *node)
+{
+	unsigned long h = mix(14695981039346656037UL, node->type);
+	switch (node->type) {
+	case REL_NODE:
+		h = mix(h, node->u.reldat.rel);
+		h = mix(h, (uintptr_t)node->u.reldat.left);
+		h = mix(h, (uintptr_t)node->u.reldat.right);
+		h = mix(h, (uintptr_t)node->u.reldat.next);
+		break;
+	case OP_NODE:
+		h = mix(h, node->u.opdat.op);
+		h = mix(h, (uintptr_t)node->u.opdat.left);
+		h = mix(h, (uintptr_t)node->u.opdat.right);
+		break;
+	case INUM_NODE:
+		h = mix(h, node->u.ival);
+		break;
+	case BNUM_NODE:
+		h = mix(h, node->u.big->neg);
+		for (size_t i = 0; i < node->u.big->len; ++i) {
+			h = mix(h, node->u.big->limbs[i]);
+		}
+		break;
+	case RNUM_NODE: {
+		unsigned long bits;
+		memcpy(&bits, &node->u.rval, sizeof bits);
+		h = mix(h, bits);
+		break;
+	}
+	case VAR_NODE:
+		h = mix(h, node->u.sym);
+		break;
+	default:
+		fprintf(stderr, "unexpected node type %d\n", node->type);
+		abort();
+	}
+	// Carry the high bits, which pointers vary in, down to the slot index.
+	return h ^ h >> 32;
+}
+
+static bool node_eq(const ASTNode *n1, const ASTNode *n2)
+{
+	if (n1->type != n2->type) {
+		return false;
+	}
+	switch (n1->type) {
+	case REL_NODE:
+		return n1->u.reldat.rel == n2->u.reldat.rel &&
+		       n1->u.reldat.left == n2->u.reldat.left &&
+		       n1->u.reldat.right == n2->u.reldat.right &&
+		       n1->u.reldat.next == n2->u.reldat.next;
+	case OP_NODE:
+		return n1->u.opdat.op == n2->u.opdat.op &&
+		       n1->u.opdat.left == n2->u.opdat.left &&
+		       n1->u.opdat.right == n2->u.opdat.right;
+	case INUM_NODE:
+		return n1->u.ival == n2->u.ival;
+	case BNUM_NODE:
+		return !big_cmp(n1->u.big, n2->u.big);
+	case RNUM_NODE:
+		return !memcmp(&n1->u.rval, &n2->u.rval, sizeof n1->u.rval);
+	case VAR_NODE:
+		return n1->u.sym == n2->u.sym;
+	default:
+		fprintf(stderr, "unexpected node type %d\n", n1->type);
+		abort();
+	}
+}
+
+static void rehash(int nslots)
+{
+	ASTNode **old = dag.slots;
+	int nold = dag.nslots;
+	dag.slots = calloc(nslots, sizeof *dag.slots);
+	dag.nslots = nslots;
+	for (int i = 0; i < nold; ++i) {
+		if (old[i]) {
+			unsigned long j = node_hash(old[i]) & (nslots - 1);
+			while (dag.slots[j]) {
+				j = (j + 1) & (nslots - 1);
+			}
+			dag.slots[j] = old[i];
+		}
+	}
+	free(old);
+}
+
+// Return the node equal to `node`, adding a copy of it if it is new.
+static ASTNode *hash_cons(const ASTNode *node)
+{
+	if (!dag.nslots) {
+		rehash(SLOTS_INIT);
+	}
+	unsigned long i = node_hash(node) & (dag.nslots - 1);
+	for (; dag.slots[i]; i = (i + 1) & (dag.nslots - 1)) {
+		if (node_eq(dag.slots[i], node)) {
+			++dag.slots[i]->uses;
+			return dag.slots[i];
+		}
+	}
+	if (!dag.pool.size) {
+		pool_init(&dag.pool, sizeof(ASTNode));
+	}
+	ASTNode *new = pool_alloc(&dag.pool);
+	*new = *node;
+	new->uses = 1;
+	dag.slots[i] = new;
+	if (2 * ++dag.len > dag.nslots) {
+		rehash(2 * dag.nslots);
+	}
+	return new;
 }
 
-// Allocate and initialize an `OP_NODE` type node.
+// Return a `REL_NODE` type node, followed by the relations `next`.
+ASTNode *rel_node(Rel rel, ASTNode *left, ASTNode *right, ASTNode *next)
+{
+	return hash_cons(
+	    &(ASTNode){REL_NODE, .u.reldat = {rel, left, right, next}});
+}
+
+// Return an `OP_NODE` type node.
 ASTNode *op_node(Op op, ASTNode *left, ASTNode *right)
 {
-	ASTNode *node = malloc(sizeof *node);
-	*node = (ASTNode){OP_NODE, .u.opdat = {op, left, right}};
-	return node;
+	return hash_cons(&(ASTNode){OP_NODE, .u.opdat = {op, left, right}});
 }
 
-// Allocate and initialize a `INUM_NODE` type node.
+// Return a `INUM_NODE` type node.
 ASTNode *inum_node(long val)
 {
-	ASTNode *node = malloc(sizeof *node);
-	*node = (ASTNode){INUM_NODE, .u.ival = val};
+	return hash_cons(&(ASTNode){INUM_NODE, .u.ival = val});
+}
+
+// Return a `BNUM_NODE` type node, taking over `val`.
+ASTNode *bnum_node(BigInt *val)
+{
+	ASTNode *node = hash_cons(&(ASTNode){BNUM_NODE, .u.big = val});
+	if (node->u.big != val) { // An equal node exists.
+		free(val);
+	}
 	return node;
 }
 
-// Allocate and initialize a `RNUM_NODE` type node.
+// Return a `RNUM_NODE` type node.
 ASTNode *rnum_node(double val)
 {
-	ASTNode *node = malloc(sizeof *node);
-	*node = (ASTNode){RNUM_NODE, .u.rval = val};
-	return node;
+	return hash_cons(&(ASTNode){RNUM_NODE, .u.rval = val});
 }
 
-// Allocate and initialize a `VAR_NODE` type node.
-ASTNode *var_node(char *name)
+// Return a `VAR_NODE` type node.
+ASTNode *var_node(int sym)
 {
-	ASTNode *node = malloc(sizeof *node);
-	*node = (ASTNode){VAR_NODE, .u.name = name};
-	return node;
+	return hash_cons(&(ASTNode){VAR_NODE, .u.sym = sym});
+}
+
+// Release `node` along with its program and memoized result.
+static void free_node(ASTNode *node)
+{
+	free_code(node);
+	if (node->type == BNUM_NODE) {
+		free(node->u.big);
+	}
+	pool_free(&dag.pool, node);
+}
+
+// Apply `fn` to each node reachable from `node` not yet visited by the current
+// walk, along with `arg`, marking it visited. Only the stamps of the nodes are
+// modified.
+static void walk(const ASTNode *node, void (*fn)(const ASTNode *, void *),
+		 void *arg)
+{
+	ASTNode **stack = NULL;
+	int len = 0, cap = 0;
+	for (ASTNode *n = (ASTNode *)node;; n = stack[--len]) {
+		if (n && n->stamp != dag.stamp) {
+			n->stamp = dag.stamp;
+			if (fn) {
+				fn(n, arg);
+			}
+			if (len + 3 > cap) {
+				cap = cap ? 2 * cap : 64;
+				stack = realloc(stack, cap * sizeof *stack);
+			}
+			switch (n->type) {
+			case REL_NODE:
+				stack[len++] = n->u.reldat.next;
+				stack[len++] = n->u.reldat.right;
+				stack[len++] = n->u.reldat.left;
+				break;
+			case OP_NODE:
+				stack[len++] = n->u.opdat.right;
+				stack[len++] = n->u.opdat.left;
+				break;
+			default:
+				break;
+			}
+		}
+		if (!len) {
+			break;
+		}
+	}
+	free(stack);
 }
 
-// Release `node` and all its child nodes.
-void free_node(ASTNode *node)
+// Mark the nodes reachable from `node` as kept by the current collection.
+void mark_nodes(const ASTNode *node) { walk(node, NULL, NULL); }
+
+// Release the nodes the cache does not refer to, along with their programs, if
+// the table has doubled since the last collection.
+void collect_nodes(void)
 {
-	if (!node) {
+	if (dag.len < 2 * dag.live + COLLECT_MIN) {
 		return;
 	}
-	switch (node->type) {
-	case ASGN_NODE:
-		free_node(node->u.asgndat.left);
-		free_node(node->u.asgndat.right);
-		break;
-	case REL_NODE:
-		free_node(node->u.reldat.left);
-		free_node(node->u.reldat.right);
-		free_node(node->u.reldat.next);
-		break;
-	case OP_NODE:
-		free_node(node->u.opdat.left);
-		free_node(node->u.opdat.right);
-		break;
-	case INUM_NODE:
-	case RNUM_NODE:
-		break;
-	case VAR_NODE:
-		free(node->u.name);
-		break;
-	default:
-		fprintf(stderr, "unexpected node type %d\n", node->type);
-		abort();
+	++dag.stamp;
+	mark_cached();
+
+	ASTNode **old = dag.slots;
+	int nold = dag.nslots;
+	dag.live = 0;
+	for (int i = 0; i < nold; ++i) {
+		if (old[i] && old[i]->stamp == dag.stamp) {
+			++dag.live;
+		}
+	}
+	int nslots = SLOTS_INIT;
+	while (nslots < 2 * dag.live) {
+		nslots *= 2;
+	}
+	dag.slots = calloc(nslots, sizeof *dag.slots);
+	dag.nslots = nslots;
+	dag.len = dag.live;
+	for (int i = 0; i < nold; ++i) {
+		if (!old[i]) {
+			continue;
+		}
+		if (old[i]->stamp != dag.stamp) {
+			free_node(old[i]);
+			continue;
+		}
+		unsigned long j = node_hash(old[i]) & (nslots - 1);
+		while (dag.slots[j]) {
+			j = (j + 1) & (nslots - 1);
+		}
+		dag.slots[j] = old[i];
 	}
-	free(node);
+	free(old);
 }
 
-// Print an S-exp of the subtree under `node`.
-void print_node(const ASTNode *node)
+typedef struct Syms {
+	int *syms;
+	int len, cap;
+} Syms;
+
+static void add_sym(const ASTNode *node, void *arg)
 {
-	static const char OP_SYM[] = {'+', '-', '*', '/', '^', '-'};
-	static const char REL_SYM[][3] = {"", "=", ">", ">=", "<", "<="};
+	Syms *s = arg;
+	if (node->type != VAR_NODE) {
+		return;
+	}
+	if (s->len == s->cap) {
+		s->cap = s->cap ? 2 * s->cap : 8;
+		s->syms = realloc(s->syms, s->cap * sizeof *s->syms);
+	}
+	s->syms[s->len++] = node->u.sym;
+}
+
+// Return the symbols of the variables under `node`, and store their number to
+// `*n`.
+int *node_syms(const ASTNode *node, int *n)
+{
+	Syms s = {NULL, 0, 0};
+	++dag.stamp;
+	walk(node, add_sym, &s);
+	*n = s.len;
+	return s.syms;
+}
 
+// Release the hash-consed nodes along with their programs and memoized
+// results.
+void free_nodes(void)
+{
+	for (int i = 0; i < dag.nslots; ++i) {
+		if (dag.slots[i]) {
+			free_node(dag.slots[i]);
+		}
+	}
+	free_codes();
+	free_pool(&dag.pool);
+	free(dag.slots);
+	dag.slots = NULL;
+	dag.len = dag.nslots = dag.live = 0;
+}
+
+// Apply `fn` to each expression of the statement `node`.
+static void each_expr(ASTNode *node, void (*fn)(ASTNode *))
+{
 	switch (node->type) {
 	case ASGN_NODE:
-		printf("(:= ");
-		print_node(node->u.asgndat.left);
-		putchar(' ');
-		print_node(node->u.asgndat.right);
-		putchar(')');
+		fn(node->u.asgndat.right);
 		return;
 	case REL_NODE:
-		printf("(%s ", REL_SYM[node->u.reldat.rel]);
-		print_node(node->u.reldat.left);
-		putchar(' ');
-		print_node(node->u.reldat.right);
-		putchar(')');
-		if (node->u.reldat.next) {
-			printf(" & ");
-			print_node(node->u.reldat.next);
-		}
-		return;
-	case OP_NODE:
-		printf("(%c ", OP_SYM[node->u.opdat.op]);
-		print_node(node->u.opdat.left);
-		if (node->u.opdat.op != NEG) {
-			putchar(' ');
-			print_node(node->u.opdat.right);
+		for (; node; node = node->u.reldat.next) {
+			fn(node->u.reldat.left);
+			fn(node->u.reldat.right);
 		}
-		putchar(')');
 		return;
-	case INUM_NODE:
-		printf("%ld", node->u.ival);
+	default:
+		fn(node);
 		return;
-	case RNUM_NODE:
-		printf("%lf", node->u.rval);
+	}
+}
+
+// Whether the statement `node` is streamed.
+bool streamed(const ASTNode *node)
+{
+	return stream_terms && node->type == OP_NODE &&
+	       (node->u.opdat.op == MUL || node->u.opdat.op == POW);
+}
+
+// Compile the expressions of the statement `node`.
+void compile_stmt(ASTNode *node)
+{
+	if (streamed(node)) {
+		compile(node->u.opdat.left);
+		compile(node->u.opdat.right);
 		return;
-	case VAR_NODE:
-		printf("%s", node->u.name);
+	}
+	each_expr(node, compile);
+}
+
+static void free_unshared(ASTNode *node)
+{
+	if (node->uses < 2) {
+		free_code(node);
+	}
+}
+
+// Release the memos made by the statement `node`, and its programs which no
+// other statement can run.
+void free_stmt_code(ASTNode *node)
+{
+	free_memos();
+	if (streamed(node)) {
+		free_unshared(node->u.opdat.left);
+		free_unshared(node->u.opdat.right);
 		return;
-	default:
-		fprintf(stderr, "unexpected node type %d\n", node->type);
-		abort();
 	}
+	each_expr(node, free_unshared);
 }
 
-// Return the resulting polynomial evaluating the subtree under `node`.
-TermNode *eval_poly(const ASTNode *node, const EnvFrame *env)
+// The pending work of `print_node`: a node to print, or the text to print
+// between nodes if `node` is `NULL`.
+typedef struct PrintItem {
+	const ASTNode *node;
+	const char *str;
+} PrintItem;
+
+typedef struct PrintStack {
+	PrintItem *items;
+	int len, cap;
+} PrintStack;
+
+static void push_item(PrintStack *st, const ASTNode *node, const char *str)
 {
-	if (!node) { // for NEG op
-		return NULL;
+	if (st->len == st->cap) {
+		st->cap = st->cap ? 2 * st->cap : 64;
+		st->items = realloc(st->items, st->cap * sizeof *st->items);
 	}
-	switch (node->type) {
-	case OP_NODE: {
-		Op op = node->u.opdat.op;
-		TermNode *lt = eval_poly(node->u.opdat.left, env);
-		TermNode *rt = eval_poly(node->u.opdat.right, env);
-
-		// Result of `eval_poly` being `NULL` indicates an invalid
-		// syntax or an operation, except for the result of evaluating
-		// the right child of the `NEG` op.
-		if (!lt || (!rt && op != NEG)) {
-			free_poly(lt);
-			free_poly(rt);
-			return NULL;
-		}
+	st->items[st->len++] = (PrintItem){node, str};
+}
+
+// Print an S-exp of the subtree under `node`.
+// The parts left to print are kept on an explicit stack, last one first, so
+// that arbitrarily deep trees take no native stack.
+void print_node(const ASTNode *node)
+{
+	static const char OP_SYM[] = {'+', '-', '*', '/', '^', '-'};
+	static const char REL_SYM[][3] = {"", "=", ">", ">=", "<", "<="};
 
-		bool success;
-		switch (op) {
-		case ADD:
-			success = add_poly(&lt, rt);
+	PrintStack st = {NULL, 0, 0};
+	push_item(&st, node, NULL);
+	while (st.len) {
+		PrintItem it = st.items[--st.len];
+		if (!(node = it.node)) {
+			out_str(it.str);
+			continue;
+		}
+		switch (node->type) {
+		case ASGN_NODE:
+			out_str("(:= ");
+			push_item(&st, NULL, ")");
+			push_item(&st, node->u.asgndat.right, NULL);
+			push_item(&st, NULL, " ");
+			push_item(&st, node->u.asgndat.left, NULL);
+			break;
+		case REL_NODE:
+			out_char('(');
+			out_str(REL_SYM[node->u.reldat.rel]);
+			out_char(' ');
+			if (node->u.reldat.next) {
+				push_item(&st, node->u.reldat.next, NULL);
+				push_item(&st, NULL, " & ");
+			}
+			push_item(&st, NULL, ")");
+			push_item(&st, node->u.reldat.right, NULL);
+			push_item(&st, NULL, " ");
+			push_item(&st, node->u.reldat.left, NULL);
 			break;
-		case SUB:
-			success = sub_poly(&lt, rt);
+		case OP_NODE:
+			out_char('(');
+			out_char(OP_SYM[node->u.opdat.op]);
+			out_char(' ');
+			push_item(&st, NULL, ")");
+			if (node->u.opdat.op != NEG) {
+				push_item(&st, node->u.opdat.right, NULL);
+				push_item(&st, NULL, " ");
+			}
+			push_item(&st, node->u.opdat.left, NULL);
 			break;
-		case MUL:
-			success = mul_poly(&lt, rt);
+		case INUM_NODE:
+			out_long(node->u.ival);
 			break;
-		case DIV:
-			success = div_poly(&lt, rt);
+		case BNUM_NODE: {
+			char *s = big_str(node->u.big);
+			out_str(s);
+			free(s);
 			break;
-		case POW:
-			success = pow_poly(&lt, rt);
+		}
+		case RNUM_NODE:
+			out_double(node->u.rval);
 			break;
-		case NEG:
-			success = neg_poly(lt);
+		case VAR_NODE:
+			out_str(sym_name(node->u.sym));
 			break;
 		default:
-			fprintf(stderr, "unknown op type %d\n", op);
+			fprintf(stderr, "unexpected node type %d\n",
+				node->type);
 			abort();
 		}
-		if (!success) {
-			free_poly(lt);
-			return NULL;
-		}
-		return lt;
 	}
-	case INUM_NODE:
-		return icoeff_term(node->u.ival);
-	case RNUM_NODE:
-		return rcoeff_term(node->u.rval);
-	case VAR_NODE: {
-		TermNode *p;
-		// Check if there is already a term assigned to `node->u.name`
-		// in `env`.
-		if ((p = lookup(node->u.name, env))) {
-			return poly_dup(p);
-		} else {
-			p = icoeff_term(1);
-			TermNode *vt = var_term(node->u.name, 1);
-			p->u.vars = vt;
-			return p;
-		}
+	free(st.items);
+}
+
+// Return the resulting polynomial evaluating the subtree under `node`.
+TermNode *eval_poly(const ASTNode *node, const Env *env)
+{
+	TermNode *p = cached_poly(node, env);
+	if (p) {
+		return p;
 	}
-	default:
-		fprintf(stderr, "unexpected node type %d\n", node->type);
-		abort();
+	if ((p = run(node, env))) {
+		cache_poly(node, env, p);
 	}
+	return p;
 }
 
-// Return the resulting relation evaluating the subtree under `node`.
-RelNode *eval_rel(const ASTNode *node, const EnvFrame *env)
+// Return a stream of the terms evaluating the statement `node`, which must be
+// streamed, or `NULL` after an exception.
+// The operands are evaluated as usual, but the result is neither built nor
+// cached.
+PolyStream *eval_stream(const ASTNode *node, const Env *env)
 {
-	TermNode *left = eval_poly(node->u.reldat.left, env);
-	TermNode *right = eval_poly(node->u.reldat.right, env);
-	if (!left || !right) { // Exception while evaluating `left` or `right`.
+	TermNode *left = eval_poly(node->u.opdat.left, env);
+	if (!left) {
+		return NULL;
+	}
+	TermNode *right = eval_poly(node->u.opdat.right, env);
+	if (!right) {
 		free_poly(left);
-		free_poly(right);
 		return NULL;
 	}
+	if (node->u.opdat.op == MUL) {
+		return stream_mul(left, right);
+	}
+	return stream_pow(left, right);
+}
 
-	// Both `left` and `right` are now owned by `r`.
-	RelNode *r = rnode(node->u.reldat.rel, left, right);
-	RelNode *hd = NULL; // For rest of the relations in the system.
-	if (norm_rel(r)) {
-		if (!r->left->u.vars && !verify_nrel(r)) {
-			goto inconsistent_sys;
+// Return the resulting relation evaluating the subtree under `node`.
+// The relations are evaluated from the first one, and added to a system solved
+// as they are. Once it has no solution, the rest are not evaluated.
+static RelNode *eval_rels(const ASTNode *node, const Env *env)
+{
+	System *s = new_system();
+	for (; node; node = node->u.reldat.next) {
+		TermNode *left = run(node->u.reldat.left, env);
+		TermNode *right = run(node->u.reldat.right, env);
+		if (!left || !right) { // Exception while evaluating them.
+			free_poly(left);
+			free_poly(right);
+			free_system(s);
+			return NULL;
 		}
-		if (node->u.reldat.next) {
-			hd = eval_rel(node->u.reldat.next, env);
-			if (!hd) { // Exception in previous relations.
-				goto r_cleanup;
-			}
-			if (!hd->rel) {
-				goto inconsistent_sys;
-			}
-			int c;
-			RelNode **p = &hd;
-			while (*p && (c = poly_cmp(r->left, (*p)->left)) < 0) {
-				p = &(*p)->next;
-			}
-			if (*p && !c) { // Same polynomial found.
-				Rel rel = merge_rel(r->rel, (*p)->rel);
-				if (rel) {
-					free_rel(r);
-					(*p)->rel = rel;
-					return hd;
-				} else {
-					goto inconsistent_sys;
-				}
-			} else {
-				r->next = *p;
-				*p = r;
-				return hd;
-			}
-		} else {
-			return r;
+
+		// Both `left` and `right` are now owned by `r`.
+		RelNode *r = rnode(node->u.reldat.rel, left, right);
+		if (!norm_rel(r)) {
+			free_rel(r);
+			free_system(s);
+			return NULL;
+		}
+		if (!add_rel(s, r)) {
+			break;
 		}
 	}
-r_cleanup:
-	free_rel(r);
-	return NULL;
-inconsistent_sys:
-	free_rel(hd);
-	free_poly(r->left);
-	free_poly(r->right);
-	r->left = r->right = NULL;
-	r->rel = 0;
+	return solve(s);
+}
+
+// Return the resulting relation evaluating the subtree under `node`.
+RelNode *eval_rel(const ASTNode *node, const Env *env)
+{
+	RelNode *r = cached_rel(node, env);
+	if (r) {
+		return r;
+	}
+	if ((r = eval_rels(node, env))) {
+		cache_rel(node, env, r);
+	}
 	return r;
 }
 
 // Return the assigned polynomial. `NULL` indicates a duplicate definition or a
 // self-reference.
-TermNode *eval_asgn(const ASTNode *node, EnvFrame **env)
+TermNode *eval_asgn(const ASTNode *node, Env *env)
 {
-	// Setup the variable name (LHS)
-	const char *name = node->u.asgndat.left->u.name;
-	char *s = malloc(strlen(name) + 1);
-	strcpy(s, name);
+	// The variable (LHS)
+	int sym = node->u.asgndat.left->u.sym;
 
-	TermNode *poly = eval_poly(node->u.asgndat.right, *env);
+	TermNode *poly = eval_poly(node->u.asgndat.right, env);
+	if (!poly) {
+		return NULL;
+	}
 	// Search for a cyclic definition.
 	for (TermNode *t = poly; t; t = t->next) {
 		for (TermNode *var = t->u.vars; var; var = var->next) {
 			// Variables are sorted reverse-lexicographically.
-			int cmp = -strcmp(var->hd.name, s);
+			int cmp = -sym_cmp(var->hd.sym, sym);
 			if (cmp == 0) { // A self-reference is found.
 				goto cleanup;
 			} else if (cmp < 0) {
@@ -294,12 +595,12 @@ TermNode *eval_asgn(const ASTNode *node, EnvFrame **env)
 		}
 	}
 
-	if (!set_var(s, poly, env)) { // A variable named `name` already exists.
+	if (!set_var(sym, poly, env)) { // A variable `sym` already exists.
 		goto cleanup;
 	}
-	return poly;
+	free_poly(poly);
+	return lookup(sym, env);
 cleanup:
 	free_poly(poly);
-	free(s);
 	return NULL;
 }
@@ -8,6 +8,7 @@ typedef struct ASTNode {
 	       REL_NODE,
 	       OP_NODE,
 	       INUM_NODE,
+	       BNUM_NODE,
 	       RNUM_NODE,
 	       VAR_NODE } type;
 	union {
@@ -21,51 +22,111 @@ typedef struct ASTNode {
 		struct {
 			enum Op { ADD, SUB, MUL, DIV, POW, NEG } op;
 			struct ASTNode *left, *right;
-		} opdat;     // OP_NODE
-		long ival;   // INUM_NODE
-		double rval; // RNUM_NODE
-		char *name;  // VAR_NODE
+		} opdat;	    // OP_NODE
+		long ival;	    // INUM_NODE
+		struct BigInt *big; // BNUM_NODE, not fitting in a `long`
+		double rval;	    // RNUM_NODE
+		int sym;	    // VAR_NODE
 	} u;
+
+	// Expression nodes only; see below.
+	unsigned uses;	       // Times the node has been constructed
+	struct TermNode *memo; // Memoized result of evaluating the node
+	struct Program *code;  // The node compiled as a whole expression
+
+	unsigned long stamp; // The last walk over the nodes visiting it
 } ASTNode;
 
 typedef enum Rel Rel;
 typedef enum Op Op;
 
+// `ASGN_NODE`s are allocated from `stmt_arena`, and released along with it.
+// Other nodes are hash-consed instead: constructing a node equal to an existing
+// one returns the existing node, so repeated subexpressions form a DAG spanning
+// the statements, and identical statements share their root. Nodes are kept
+// while the cache refers to them, and the others are collected from time to
+// time between statements. An expression node constructed more than once
+// memoizes the result of its evaluation, which is reused for the rest of the
+// statement; results are only reused across statements by the cache.
+
 // Allocate and initialize a `ASGN_NODE` type node.
 ASTNode *asgn_node(ASTNode *left, ASTNode *right);
 
-// Allocate and initialize a `REL_NODE` type node.
-ASTNode *rel_node(Rel rel, ASTNode *left, ASTNode *right);
+// Return a `REL_NODE` type node, followed by the relations `next`.
+ASTNode *rel_node(Rel rel, ASTNode *left, ASTNode *right, ASTNode *next);
 
-// Allocate and initialize an `OP_NODE` type node.
+// Return an `OP_NODE` type node.
 ASTNode *op_node(Op op, ASTNode *left, ASTNode *right);
 
-// Allocate and initialize a `INUM_NODE` type node.
+// Return a `INUM_NODE` type node.
 ASTNode *inum_node(long val);
 
-// Allocate and initialize a `RNUM_NODE` type node.
+struct BigInt;
+// Return a `BNUM_NODE` type node, taking over `val`.
+ASTNode *bnum_node(struct BigInt *val);
+
+// Return a `RNUM_NODE` type node.
 ASTNode *rnum_node(double val);
 
-// Allocate and initialize a `VAR_NODE` type node.
-ASTNode *var_node(char *name);
+// Return a `VAR_NODE` type node.
+ASTNode *var_node(int sym);
+
+// Whether evaluation memoizes the results of repeated expressions, true by
+// default. The memos are kept in nodes shared by all statements, and so must be
+// turned off while statements are evaluated concurrently.
+extern bool memoize;
+
+// Whether products and powers evaluated as whole statements are streamed, false
+// by default. Only their operands are compiled, and their terms are printed as
+// they are produced by `eval_stream`.
+extern bool stream_terms;
+
+// Whether the statement `node` is streamed.
+bool streamed(const ASTNode *node);
 
-// Release `node` and all its child nodes.
-void free_node(ASTNode *node);
+// Mark the nodes reachable from `node` as kept by the current collection.
+void mark_nodes(const ASTNode *node);
+
+// Release the nodes the cache does not refer to, along with their programs, if
+// enough nodes have been made since the last collection. Every statement made
+// must have been evaluated.
+void collect_nodes(void);
+
+// Return the symbols of the variables under `node`, and store their number to
+// `*n`.
+int *node_syms(const ASTNode *node, int *n);
+
+// Release the hash-consed nodes along with their programs and memoized
+// results.
+void free_nodes(void);
+
+// Compile the expressions of the statement `node`, which must be done before
+// it is evaluated.
+void compile_stmt(ASTNode *node);
+
+// Release the memos made by the statement `node`, and its programs which no
+// other statement can run.
+void free_stmt_code(ASTNode *node);
 
 // Print an S-exp of the subtree under `node`.
 void print_node(const ASTNode *node);
 
 struct TermNode;
-struct EnvFrame;
+struct Env;
 // Return the resulting polynomial evaluating the subtree under `node`.
-struct TermNode *eval_poly(const ASTNode *node, const struct EnvFrame *env);
+struct TermNode *eval_poly(const ASTNode *node, const struct Env *env);
+
+struct PolyStream;
+// Return a stream of the terms evaluating the statement `node`, which must be
+// streamed, or `NULL` after an exception.
+struct PolyStream *eval_stream(const ASTNode *node, const struct Env *env);
 
 struct RelNode;
 // Return the resulting relation evaluating the subtree under `node`.
-struct RelNode *eval_rel(const ASTNode *node, const struct EnvFrame *env);
+struct RelNode *eval_rel(const ASTNode *node, const struct Env *env);
 
 // Return the assigned polynomial. `NULL` indicates a duplicate definition or a
 // self-reference.
-struct TermNode *eval_asgn(const ASTNode *node, struct EnvFrame **env);
+struct TermNode *eval_asgn(const ASTNode *node, struct Env *env);
 
 #endif /* ifndef AST_H */
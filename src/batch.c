@@ -0,0 +1,383 @@
+#define _POSIX_C_SOURCE 200809L // open_memstream
+#include "batch.h"
+#include "out.h"
+#include "pool.h"
+#include "stats.h"
+#include "term.h"
+#include "util.h"
+#include "vec.h"
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+typedef struct Stmt {
+	const ASTNode *node;
+	long out_end, err_end; // Ends of the output printed while parsing it
+	StmtStats stats;       // Statistics of parsing it
+	char *out, *err;       // Output printed while evaluating it
+	size_t out_len, err_len;
+	int *succs; // Statements waiting for this one
+	int nsuccs, cap;
+	int npreds; // Statements this one is waiting for
+	bool done;
+} Stmt;
+
+// The uses and the assignment of a symbol seen so far.
+typedef struct SymDeps {
+	int writer;   // The last statement assigning the symbol, or -1
+	int *readers; // Statements using the symbol since then
+	int nreaders, cap;
+	int seen; // The last statement found using the symbol
+} SymDeps;
+
+static struct {
+	Stmt *stmts;
+	int len, cap;
+	FILE *out, *err; // Capture the output printed while parsing.
+	char *out_buf, *err_buf;
+	size_t out_len, err_len;
+
+	SymDeps *syms;
+	int nsyms;
+
+	pthread_mutex_t lock;
+	pthread_cond_t ready_cond; // Signaled when idle workers have work to do
+	pthread_cond_t done_cond;  // Signaled when `awaited` is done
+	int *ready;		   // Min-heap of the statements ready to run
+	int nready, nstarted;
+	int nidle;   // Workers waiting for a statement to be ready
+	int awaited; // The statement waited for to print its output
+	Env *env;
+	bool verbose;
+	int vec_threads; // Threads each worker may multiply on
+	void (*run)(const ASTNode *node, Env *env, bool verbose);
+} batch = {
+    .lock = PTHREAD_MUTEX_INITIALIZER,
+    .ready_cond = PTHREAD_COND_INITIALIZER,
+    .done_cond = PTHREAD_COND_INITIALIZER,
+    .awaited = -1,
+};
+
+// Start recording statements, capturing the output printed while parsing them.
+void batch_begin(void)
+{
+	batch.out = open_memstream(&batch.out_buf, &batch.out_len);
+	batch.err = open_memstream(&batch.err_buf, &batch.err_len);
+	stmt_out = batch.out;
+	stmt_err = batch.err;
+}
+
+// Record `node`, the statement just parsed.
+void batch_add(const ASTNode *node)
+{
+	out_flush();
+	if (batch.len == batch.cap) {
+		batch.cap = batch.cap ? 2 * batch.cap : 64;
+		batch.stmts = realloc(batch.stmts,
+				      batch.cap * sizeof *batch.stmts);
+	}
+	batch.stmts[batch.len++] = (Stmt){.node = node,
+					  .out_end = ftell(batch.out),
+					  .err_end = ftell(batch.err),
+					  .stats = stmt_stats};
+}
+
+static SymDeps *sym_deps(int sym)
+{
+	if (sym >= batch.nsyms) {
+		int n = batch.nsyms ? 2 * batch.nsyms : 64;
+		while (n <= sym) {
+			n *= 2;
+		}
+		batch.syms = realloc(batch.syms, n * sizeof *batch.syms);
+		for (int i = batch.nsyms; i < n; ++i) {
+			batch.syms[i] = (SymDeps){-1, NULL, 0, 0, -1};
+		}
+		batch.nsyms = n;
+	}
+	return &batch.syms[sym];
+}
+
+// Make statement `to` wait for statement `from`.
+static void add_edge(int from, int to)
+{
+	Stmt *s = &batch.stmts[from];
+	if (s->nsuccs && s->succs[s->nsuccs - 1] == to) {
+		return;
+	}
+	if (s->nsuccs == s->cap) {
+		s->cap = s->cap ? 2 * s->cap : 4;
+		s->succs = realloc(s->succs, s->cap * sizeof *s->succs);
+	}
+	s->succs[s->nsuccs++] = to;
+	++batch.stmts[to].npreds;
+}
+
+// Make statement `i` wait for the last assignments of the variables under
+// `node`. The nodes left to visit are kept on an explicit stack, so that
+// arbitrarily deep trees take no native stack.
+static void add_uses(const ASTNode *node, int i)
+{
+	const ASTNode **stack = NULL;
+	int len = 0, cap = 0;
+	for (;;) {
+		if (len + 3 > cap) {
+			cap = cap ? 2 * cap : 64;
+			stack = realloc(stack, cap * sizeof *stack);
+		}
+		switch (node->type) {
+		case REL_NODE:
+			stack[len++] = node->u.reldat.left;
+			stack[len++] = node->u.reldat.right;
+			if (node->u.reldat.next) {
+				stack[len++] = node->u.reldat.next;
+			}
+			break;
+		case OP_NODE:
+			stack[len++] = node->u.opdat.left;
+			if (node->u.opdat.op != NEG) {
+				stack[len++] = node->u.opdat.right;
+			}
+			break;
+		case INUM_NODE:
+		case BNUM_NODE:
+		case RNUM_NODE:
+			break;
+		case VAR_NODE: {
+			SymDeps *d = sym_deps(node->u.sym);
+			if (d->seen == i) {
+				break;
+			}
+			d->seen = i;
+			if (d->writer >= 0) {
+				add_edge(d->writer, i);
+			}
+			if (d->nreaders == d->cap) {
+				d->cap = d->cap ? 2 * d->cap : 4;
+				d->readers =
+				    realloc(d->readers,
+					    d->cap * sizeof *d->readers);
+			}
+			d->readers[d->nreaders++] = i;
+			break;
+		}
+		default:
+			fprintf(stderr, "unexpected node type %d\n",
+				node->type);
+			abort();
+		}
+		if (!len) {
+			break;
+		}
+		node = stack[--len];
+	}
+	free(stack);
+}
+
+// Make statement `i`, assigning `sym`, wait for the earlier statements using or
+// assigning `sym`.
+static void add_def(int sym, int i)
+{
+	SymDeps *d = sym_deps(sym);
+	if (d->writer >= 0) {
+		add_edge(d->writer, i);
+	}
+	for (int j = 0; j < d->nreaders; ++j) {
+		if (d->readers[j] != i) {
+			add_edge(d->readers[j], i);
+		}
+	}
+	d->nreaders = 0;
+	d->writer = i;
+}
+
+static void push_ready(int i)
+{
+	int *h = batch.ready;
+	int k = batch.nready++;
+	for (; k && h[(k - 1) / 2] > i; k = (k - 1) / 2) {
+		h[k] = h[(k - 1) / 2];
+	}
+	h[k] = i;
+}
+
+static int pop_ready(void)
+{
+	int *h = batch.ready;
+	int top = h[0], last = h[--batch.nready];
+	int k = 0;
+	for (;;) {
+		int c = 2 * k + 1;
+		if (c >= batch.nready) {
+			break;
+		}
+		if (c + 1 < batch.nready && h[c + 1] < h[c]) {
+			++c;
+		}
+		if (h[c] >= last) {
+			break;
+		}
+		h[k] = h[c];
+		k = c;
+	}
+	h[k] = last;
+	return top;
+}
+
+// Run ready statements until every statement has been started. The earliest
+// ready statement is run first, so that the output can be printed early.
+static void *work(void *arg)
+{
+	(void)arg;
+	Arena arena = {NULL, 0};
+	Pool terms;
+	pool_init(&terms, sizeof(TermNode));
+	stmt_arena = &arena;
+	term_pool = &terms;
+	vec_threads = batch.vec_threads;
+
+	pthread_mutex_lock(&batch.lock);
+	for (;;) {
+		while (!batch.nready && batch.nstarted < batch.len) {
+			++batch.nidle;
+			pthread_cond_wait(&batch.ready_cond, &batch.lock);
+			--batch.nidle;
+		}
+		if (!batch.nready) {
+			break;
+		}
+		int i = pop_ready();
+		Stmt *s = &batch.stmts[i];
+		// Idle workers are woken up to finish once all are started.
+		if (++batch.nstarted == batch.len && batch.nidle) {
+			pthread_cond_broadcast(&batch.ready_cond);
+		}
+		pthread_mutex_unlock(&batch.lock);
+
+		stmt_out = open_memstream(&s->out, &s->out_len);
+		stmt_err = open_memstream(&s->err, &s->err_len);
+		stmt_stats = s->stats;
+		batch.run(s->node, batch.env, batch.verbose);
+		fclose(stmt_out);
+		fclose(stmt_err);
+		arena_reset(&arena);
+		pool_reset(&terms);
+
+		pthread_mutex_lock(&batch.lock);
+		s->done = true;
+		for (int j = 0; j < s->nsuccs; ++j) {
+			if (!--batch.stmts[s->succs[j]].npreds) {
+				push_ready(s->succs[j]);
+				if (batch.nidle) {
+					pthread_cond_signal(&batch.ready_cond);
+				}
+			}
+		}
+		if (i == batch.awaited) {
+			pthread_cond_signal(&batch.done_cond);
+		}
+	}
+	pthread_mutex_unlock(&batch.lock);
+
+	free_pool(&terms);
+	free_arena(&arena);
+	return NULL;
+}
+
+// Evaluate the recorded statements by `run` on `nworkers` threads, or one per
+// online CPU if `nworkers` is 0, and print their output in the order of the
+// input.
+void batch_run(Env *env, bool verbose, int nworkers,
+	       void (*run)(const ASTNode *node, Env *env, bool verbose))
+{
+	out_flush();
+	fclose(batch.out);
+	fclose(batch.err);
+	stmt_out = stdout;
+	stmt_err = stderr;
+
+	// Assigned variables are declared ahead, so that assigning them
+	// concurrently leaves the table of `env` as is.
+	for (int i = 0; i < batch.len; ++i) {
+		const ASTNode *node = batch.stmts[i].node;
+		if (node->type == ASGN_NODE) {
+			add_uses(node->u.asgndat.right, i);
+			add_def(node->u.asgndat.left->u.sym, i);
+			declare_var(node->u.asgndat.left->u.sym, env);
+		} else {
+			add_uses(node, i);
+		}
+	}
+	for (int i = 0; i < batch.nsyms; ++i) {
+		free(batch.syms[i].readers);
+	}
+	free(batch.syms);
+
+	batch.ready = malloc(batch.len * sizeof *batch.ready);
+	for (int i = 0; i < batch.len; ++i) {
+		if (!batch.stmts[i].npreds) {
+			push_ready(i);
+		}
+	}
+	if (!nworkers) {
+		long ncpus = sysconf(_SC_NPROCESSORS_ONLN);
+		nworkers = ncpus > 0 ? ncpus : 1;
+	}
+	batch.env = env;
+	batch.verbose = verbose;
+	batch.run = run;
+	batch.vec_threads = vec_threads > nworkers ? vec_threads / nworkers : 1;
+	// Fewer workers do, if some cannot be started; with none at all, the
+	// statements are evaluated here, with the allocators of a worker.
+	pthread_t *tids = malloc(nworkers * sizeof *tids);
+	int nstarted = 0;
+	for (int i = 0; i < nworkers; ++i) {
+		nstarted += !pthread_create(&tids[nstarted], NULL, work, NULL);
+	}
+	if (!nstarted) {
+		Arena *arena = stmt_arena;
+		Pool *pool = term_pool;
+		int threads = vec_threads;
+		work(NULL);
+		stmt_arena = arena;
+		term_pool = pool;
+		vec_threads = threads;
+		stmt_out = stdout;
+		stmt_err = stderr;
+	}
+
+	size_t out_pos = 0, err_pos = 0;
+	for (int i = 0; i < batch.len; ++i) {
+		Stmt *s = &batch.stmts[i];
+		pthread_mutex_lock(&batch.lock);
+		batch.awaited = i;
+		while (!s->done) {
+			pthread_cond_wait(&batch.done_cond, &batch.lock);
+		}
+		pthread_mutex_unlock(&batch.lock);
+		// Output printed while parsing precedes the statement's own.
+		fwrite(batch.out_buf + out_pos, 1, s->out_end - out_pos,
+		       stdout);
+		fwrite(batch.err_buf + err_pos, 1, s->err_end - err_pos,
+		       stderr);
+		out_pos = s->out_end;
+		err_pos = s->err_end;
+		fwrite(s->out, 1, s->out_len, stdout);
+		fwrite(s->err, 1, s->err_len, stderr);
+		free(s->out);
+		free(s->err);
+		free(s->succs);
+	}
+	fwrite(batch.out_buf + out_pos, 1, batch.out_len - out_pos, stdout);
+	fwrite(batch.err_buf + err_pos, 1, batch.err_len - err_pos, stderr);
+
+	for (int i = 0; i < nstarted; ++i) {
+		pthread_join(tids[i], NULL);
+	}
+	free(tids);
+	free(batch.ready);
+	free(batch.stmts);
+	free(batch.out_buf);
+	free(batch.err_buf);
+}
@@ -0,0 +1,28 @@
+#ifndef BATCH_H
+#define BATCH_H
+
+#include "asgn.h"
+#include "ast.h"
+#include <stdbool.h>
+
+// In batch mode the whole input is parsed before any statement is evaluated,
+// and statements are then evaluated concurrently. A statement using a variable
+// waits for the earlier statements assigning it, and a statement assigning a
+// variable waits for the earlier ones using or assigning it, so that each
+// statement sees the environment as of its place in the input. The output of
+// every statement is captured, and printed in the order of the input.
+
+// Start recording statements, capturing the output printed while parsing them.
+void batch_begin(void);
+
+// Record `node`, the statement just parsed.
+void batch_add(const ASTNode *node);
+
+// Evaluate the recorded statements by `run` on `nworkers` threads, or one per
+// online CPU if `nworkers` is 0, and print their output in the order of the
+// input. The `vec_threads` of the caller are shared by the workers, each of
+// which multiplies on at least one.
+void batch_run(Env *env, bool verbose, int nworkers,
+	       void (*run)(const ASTNode *node, Env *env, bool verbose));
+
+#endif /* ifndef BATCH_H */
@@ -0,0 +1,362 @@
+#include "bigint.h"
+#include <limits.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+static BigInt *alloc_big(size_t len)
+{
+	BigInt *b = malloc(sizeof *b + len * sizeof *b->limbs);
+	b->neg = false;
+	b->len = len;
+	return b;
+}
+
+// Drop leading zero limbs of `b`, and clear the sign of 0.
+static BigInt *trim(BigInt *b)
+{
+	while (b->len > 1 && !b->limbs[b->len - 1]) {
+		--b->len;
+	}
+	if (b->len == 1 && !b->limbs[0]) {
+		b->neg = false;
+	}
+	return b;
+}
+
+// Compare the magnitudes of `a` and `b`.
+static int mag_cmp(const BigInt *a, const BigInt *b)
+{
+	if (a->len != b->len) {
+		return a->len > b->len ? 1 : -1;
+	}
+	for (size_t i = a->len; i--;) {
+		if (a->limbs[i] != b->limbs[i]) {
+			return a->limbs[i] > b->limbs[i] ? 1 : -1;
+		}
+	}
+	return 0;
+}
+
+// Return `|a| + |b|`.
+static BigInt *mag_add(const BigInt *a, const BigInt *b)
+{
+	if (a->len < b->len) {
+		const BigInt *tmp = a;
+		a = b;
+		b = tmp;
+	}
+	BigInt *r = alloc_big(a->len + 1);
+	uint64_t carry = 0;
+	for (size_t i = 0; i < a->len; ++i) {
+		carry += a->limbs[i];
+		if (i < b->len) {
+			carry += b->limbs[i];
+		}
+		r->limbs[i] = (uint32_t)carry;
+		carry >>= 32;
+	}
+	r->limbs[a->len] = (uint32_t)carry;
+	return trim(r);
+}
+
+// Return `|a| - |b|`, where `|a| >= |b|`.
+static BigInt *mag_sub(const BigInt *a, const BigInt *b)
+{
+	BigInt *r = alloc_big(a->len);
+	int64_t borrow = 0;
+	for (size_t i = 0; i < a->len; ++i) {
+		int64_t d = (int64_t)a->limbs[i] - borrow;
+		if (i < b->len) {
+			d -= b->limbs[i];
+		}
+		borrow = d < 0;
+		r->limbs[i] = (uint32_t)(d + (borrow << 32));
+	}
+	return trim(r);
+}
+
+// Divide the magnitude `u` of `m` limbs by a single limb `v` into `q`, and
+// return the remainder. `q` may alias `u`.
+static uint32_t div_limb(uint32_t *q, const uint32_t *u, size_t m, uint32_t v)
+{
+	uint64_t rem = 0;
+	for (size_t i = m; i--;) {
+		uint64_t num = rem << 32 | u[i];
+		q[i] = (uint32_t)(num / v);
+		rem = num % v;
+	}
+	return (uint32_t)rem;
+}
+
+// Divide the magnitude `u` of `m` limbs by `v` of `n` limbs, where
+// `m >= n >= 2` and `v[n - 1]` is non-zero, into the quotient `q` of
+// `m - n + 1` limbs and the remainder `r` of `n` limbs.
+// This is Knuth's Algorithm D (TAOCP Vol. 2, 4.3.1).
+static void div_limbs(uint32_t *q, uint32_t *r, const uint32_t *u,
+		      const uint32_t *v, size_t m, size_t n)
+{
+	const uint64_t b = (uint64_t)1 << 32;
+	// Normalize so that the leading limb of the divisor has its top bit
+	// set, which keeps the estimated quotient digit off by at most 2.
+	int s = __builtin_clz(v[n - 1]);
+	uint32_t *vn = malloc(n * sizeof *vn);
+	uint32_t *un = malloc((m + 1) * sizeof *un);
+	for (size_t i = n - 1; i > 0; --i) {
+		vn[i] = v[i] << s | (uint32_t)((uint64_t)v[i - 1] >> (32 - s));
+	}
+	vn[0] = v[0] << s;
+	un[m] = (uint32_t)((uint64_t)u[m - 1] >> (32 - s));
+	for (size_t i = m - 1; i > 0; --i) {
+		un[i] = u[i] << s | (uint32_t)((uint64_t)u[i - 1] >> (32 - s));
+	}
+	un[0] = u[0] << s;
+
+	for (size_t j = m - n + 1; j--;) {
+		uint64_t num = (uint64_t)un[j + n] << 32 | un[j + n - 1];
+		uint64_t qhat = num / vn[n - 1];
+		uint64_t rhat = num % vn[n - 1];
+		while (qhat >= b ||
+		       qhat * vn[n - 2] > (rhat << 32 | un[j + n - 2])) {
+			--qhat;
+			rhat += vn[n - 1];
+			if (rhat >= b) {
+				break;
+			}
+		}
+
+		// Multiply and subtract.
+		int64_t k = 0, t;
+		for (size_t i = 0; i < n; ++i) {
+			uint64_t p = qhat * vn[i];
+			t = un[i + j] - k - (int64_t)(p & 0xFFFFFFFF);
+			un[i + j] = (uint32_t)t;
+			k = (int64_t)(p >> 32) - (t >> 32);
+		}
+		t = un[j + n] - k;
+		un[j + n] = (uint32_t)t;
+
+		q[j] = (uint32_t)qhat;
+		if (t < 0) { // Subtracted too much; add back.
+			--q[j];
+			uint64_t c = 0;
+			for (size_t i = 0; i < n; ++i) {
+				c += (uint64_t)un[i + j] + vn[i];
+				un[i + j] = (uint32_t)c;
+				c >>= 32;
+			}
+			un[j + n] += (uint32_t)c;
+		}
+	}
+
+	for (size_t i = 0; i < n - 1; ++i) {
+		r[i] = un[i] >> s | (uint32_t)((uint64_t)un[i + 1] << (32 - s));
+	}
+	r[n - 1] = un[n - 1] >> s;
+	free(un);
+	free(vn);
+}
+
+// Allocate a `BigInt` of value `v`.
+BigInt *big_from_long(long v)
+{
+	unsigned long m = v < 0 ? -(unsigned long)v : (unsigned long)v;
+	BigInt *b = alloc_big(2);
+	b->neg = v < 0;
+	b->limbs[0] = (uint32_t)m;
+	b->limbs[1] = (uint32_t)(m >> 32);
+	return trim(b);
+}
+
+// Allocate a `BigInt` of the value of the decimal digits `s`.
+BigInt *big_from_str(const char *s)
+{
+	// Every 9 digits take less than a limb.
+	BigInt *b = alloc_big(strlen(s) / 9 + 1);
+	b->len = 1;
+	b->limbs[0] = 0;
+	for (; *s; ++s) {
+		uint64_t carry = *s - '0';
+		for (size_t i = 0; i < b->len; ++i) {
+			carry += (uint64_t)b->limbs[i] * 10;
+			b->limbs[i] = (uint32_t)carry;
+			carry >>= 32;
+		}
+		if (carry) {
+			b->limbs[b->len++] = (uint32_t)carry;
+		}
+	}
+	return b;
+}
+
+// Store the value of `b` to `*v` and return true if it fits in a `long`.
+bool big_to_long(const BigInt *b, long *v)
+{
+	if (b->len > 2) {
+		return false;
+	}
+	unsigned long m = b->limbs[0];
+	if (b->len == 2) {
+		m |= (unsigned long)b->limbs[1] << 32;
+	}
+	if (b->neg) {
+		if (m > (unsigned long)LONG_MAX + 1) {
+			return false;
+		}
+		*v = m ? -(long)(m - 1) - 1 : 0;
+	} else {
+		if (m > LONG_MAX) {
+			return false;
+		}
+		*v = (long)m;
+	}
+	return true;
+}
+
+// Return the nearest `double` to `b`.
+double big_to_double(const BigInt *b)
+{
+	double d = 0;
+	for (size_t i = b->len; i--;) {
+		d = ldexp(d, 32) + b->limbs[i];
+	}
+	return b->neg ? -d : d;
+}
+
+// Duplicate `b`.
+BigInt *big_dup(const BigInt *b)
+{
+	BigInt *r = alloc_big(b->len);
+	memcpy(r, b, sizeof *b + b->len * sizeof *b->limbs);
+	return r;
+}
+
+// Return `a + b`.
+BigInt *big_add(const BigInt *a, const BigInt *b)
+{
+	if (a->neg == b->neg) {
+		BigInt *r = mag_add(a, b);
+		r->neg = a->neg;
+		return trim(r);
+	}
+	// Opposite signs: subtract the smaller magnitude from the larger one,
+	// which determines the sign.
+	if (mag_cmp(a, b) >= 0) {
+		BigInt *r = mag_sub(a, b);
+		r->neg = a->neg;
+		return trim(r);
+	} else {
+		BigInt *r = mag_sub(b, a);
+		r->neg = b->neg;
+		return trim(r);
+	}
+}
+
+// Return `a * b`.
+BigInt *big_mul(const BigInt *a, const BigInt *b)
+{
+	BigInt *r = alloc_big(a->len + b->len);
+	memset(r->limbs, 0, r->len * sizeof *r->limbs);
+	for (size_t i = 0; i < a->len; ++i) {
+		uint64_t carry = 0;
+		for (size_t j = 0; j < b->len; ++j) {
+			carry += (uint64_t)a->limbs[i] * b->limbs[j] +
+				 r->limbs[i + j];
+			r->limbs[i + j] = (uint32_t)carry;
+			carry >>= 32;
+		}
+		r->limbs[i + b->len] = (uint32_t)carry;
+	}
+	r->neg = a->neg != b->neg;
+	return trim(r);
+}
+
+// Return `a / b` truncated toward zero, and store the remainder to `*rem`
+// unless `rem` is `NULL`. `b` must be non-zero.
+BigInt *big_divmod(const BigInt *a, const BigInt *b, BigInt **rem)
+{
+	BigInt *q, *r;
+	if (mag_cmp(a, b) < 0) {
+		q = big_from_long(0);
+		r = big_dup(a);
+	} else if (b->len == 1) {
+		q = alloc_big(a->len);
+		r = alloc_big(1);
+		r->limbs[0] = div_limb(q->limbs, a->limbs, a->len, b->limbs[0]);
+	} else {
+		q = alloc_big(a->len - b->len + 1);
+		r = alloc_big(b->len);
+		div_limbs(q->limbs, r->limbs, a->limbs, b->limbs, a->len,
+			  b->len);
+	}
+	// The remainder takes the sign of the dividend.
+	q->neg = a->neg != b->neg;
+	r->neg = a->neg;
+	trim(q);
+	trim(r);
+	if (rem) {
+		*rem = r;
+	} else {
+		free(r);
+	}
+	return q;
+}
+
+// Compare the values of `a` and `b`.
+int big_cmp(const BigInt *a, const BigInt *b)
+{
+	if (a->neg != b->neg) {
+		return a->neg ? -1 : 1;
+	}
+	int cmp = mag_cmp(a, b);
+	return a->neg ? -cmp : cmp;
+}
+
+// Return the sign of `b`: -1, 0 or 1.
+int big_sgn(const BigInt *b)
+{
+	if (b->neg) {
+		return -1;
+	}
+	return b->len > 1 || b->limbs[0];
+}
+
+// Negate `b` in place.
+void big_neg(BigInt *b)
+{
+	if (big_sgn(b)) {
+		b->neg = !b->neg;
+	}
+}
+
+// Return the decimal representation of `b`, to be released with `free`.
+// The magnitude is divided repeatedly by 10^9, yielding 9 digits at a time.
+char *big_str(const BigInt *b)
+{
+	size_t n = b->len;
+	uint32_t *mag = malloc(n * sizeof *mag);
+	memcpy(mag, b->limbs, n * sizeof *mag);
+	// Each limb holds less than 10 decimal digits.
+	size_t nchunks = 0;
+	uint32_t *chunks = malloc((n * 10 / 9 + 2) * sizeof *chunks);
+	do {
+		chunks[nchunks++] = div_limb(mag, mag, n, 1000000000);
+		while (n > 1 && !mag[n - 1]) {
+			--n;
+		}
+	} while (n > 1 || mag[0]);
+
+	char *s = malloc(nchunks * 9 + 2);
+	char *p = s;
+	if (b->neg) {
+		*p++ = '-';
+	}
+	p += sprintf(p, "%u", chunks[nchunks - 1]);
+	for (size_t i = nchunks - 1; i--;) {
+		p += sprintf(p, "%09u", chunks[i]);
+	}
+	free(chunks);
+	free(mag);
+	return s;
+}
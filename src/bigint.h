@@ -0,0 +1,55 @@
+#ifndef BIGINT_H
+#define BIGINT_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// An arbitrary-precision integer: sign and magnitude, the latter stored as
+// `len` 32-bit limbs, least significant first. The most significant limb is
+// non-zero unless the value is 0, which has a single limb.
+// Every `BigInt` is allocated on its own and released with `free`.
+typedef struct BigInt {
+	bool neg;
+	size_t len;
+	uint32_t limbs[];
+} BigInt;
+
+// Allocate a `BigInt` of value `v`.
+BigInt *big_from_long(long v);
+
+// Allocate a `BigInt` of the value of the decimal digits `s`.
+BigInt *big_from_str(const char *s);
+
+// Store the value of `b` to `*v` and return true if it fits in a `long`.
+bool big_to_long(const BigInt *b, long *v);
+
+// Return the nearest `double` to `b`.
+double big_to_double(const BigInt *b);
+
+// Duplicate `b`.
+BigInt *big_dup(const BigInt *b);
+
+// Return `a + b`.
+BigInt *big_add(const BigInt *a, const BigInt *b);
+
+// Return `a * b`.
+BigInt *big_mul(const BigInt *a, const BigInt *b);
+
+// Return `a / b` truncated toward zero, and store the remainder to `*rem`
+// unless `rem` is `NULL`. `b` must be non-zero.
+BigInt *big_divmod(const BigInt *a, const BigInt *b, BigInt **rem);
+
+// Compare the values of `a` and `b`.
+int big_cmp(const BigInt *a, const BigInt *b);
+
+// Return the sign of `b`: -1, 0 or 1.
+int big_sgn(const BigInt *b);
+
+// Negate `b` in place.
+void big_neg(BigInt *b);
+
+// Return the decimal representation of `b`, to be released with `free`.
+char *big_str(const BigInt *b);
+
+#endif /* ifndef BIGINT_H */
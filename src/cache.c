@@ -0,0 +1,291 @@
+#include "cache.h"
+#include "asgn.h"
+#include "pool.h"
+#include "rel.h"
+#include "term.h"
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+typedef struct Entry {
+	const ASTNode *node;
+	int *syms; // Symbols of the variables under `node`
+	int nsyms;
+	int bound; // Number of `syms` assigned when the result was evaluated
+	union {
+		TermNode *poly; // `node` is an expression.
+		RelNode *rel;	// `node` is a `REL_NODE`; nodes are malloc'ed.
+	} u;
+	struct Entry *prev, *next; // From the most recently used one.
+} Entry;
+
+static struct {
+	Entry **slots; // Open addressing over the entries in use.
+	unsigned long nslots;
+	Entry *ents;
+	int cap, len;
+	Entry *head, *tail;
+	Pool terms; // Terms of the cached results.
+	unsigned long hits, misses;
+	Entry *evicted; // Results evicted during the current statement
+	int nevicted, evicted_cap;
+} cache;
+
+static unsigned long hash(const ASTNode *node)
+{
+	uint64_t h = (uintptr_t)node * 0xff51afd7ed558ccd;
+	return h ^ h >> 32;
+}
+
+// Return the slot holding the entry of `node`, or the empty slot to insert it
+// to.
+static Entry **probe(const ASTNode *node)
+{
+	unsigned long mask = cache.nslots - 1;
+	unsigned long i = hash(node) & mask;
+	Entry *e;
+	while ((e = cache.slots[i]) && e->node != node) {
+		i = (i + 1) & mask;
+	}
+	return &cache.slots[i];
+}
+
+// Remove the entry at `slot`, moving back the entries probed past it.
+static void unslot(Entry **slot)
+{
+	unsigned long mask = cache.nslots - 1;
+	unsigned long i = slot - cache.slots, j = i;
+	for (;;) {
+		cache.slots[i] = NULL;
+		Entry *e;
+		do {
+			j = (j + 1) & mask;
+			if (!(e = cache.slots[j])) {
+				return;
+			}
+			// `e` stays if its home slot lies cyclically in (i, j].
+		} while (((j - (hash(e->node) & mask)) & mask) <
+			 ((j - i) & mask));
+		cache.slots[i] = e;
+		i = j;
+	}
+}
+
+static void unlink_entry(Entry *e)
+{
+	*(e->prev ? &e->prev->next : &cache.head) = e->next;
+	*(e->next ? &e->next->prev : &cache.tail) = e->prev;
+}
+
+static void link_entry(Entry *e)
+{
+	e->prev = NULL;
+	e->next = cache.head;
+	*(cache.head ? &cache.head->prev : &cache.tail) = e;
+	cache.head = e;
+}
+
+static void release(Entry *e)
+{
+	Pool *pool = term_pool;
+	term_pool = &cache.terms;
+	if (e->node->type == REL_NODE) {
+		RelNode *r = e->u.rel;
+		while (r) {
+			RelNode *next = r->next;
+			free_poly(r->left);
+			free_poly(r->right);
+			free(r);
+			r = next;
+		}
+	} else {
+		free_poly(e->u.poly);
+	}
+	term_pool = pool;
+}
+
+// Set aside the result of `e` to be released at the end of the statement, as
+// the statement may still share it.
+static void evict(Entry *e)
+{
+	if (cache.nevicted == cache.evicted_cap) {
+		cache.evicted_cap =
+		    cache.evicted_cap ? 2 * cache.evicted_cap : 16;
+		cache.evicted = realloc(
+		    cache.evicted, cache.evicted_cap * sizeof *cache.evicted);
+	}
+	cache.evicted[cache.nevicted++] = *e;
+}
+
+// Return the number of `syms` of `e` assigned in `env`.
+static int bound(const Entry *e, const Env *env)
+{
+	int n = 0;
+	for (int i = 0; i < e->nsyms; ++i) {
+		n += lookup(e->syms[i], env) != NULL;
+	}
+	return n;
+}
+
+// Return the entry of `node`, if any and valid in `env`, as the most recently
+// used one.
+static Entry *find(const ASTNode *node, const Env *env)
+{
+	if (!cache.cap) {
+		return NULL;
+	}
+	Entry *e = *probe(node);
+	if (!e || bound(e, env) != e->bound) {
+		++cache.misses;
+		return NULL;
+	}
+	++cache.hits;
+	unlink_entry(e);
+	link_entry(e);
+	return e;
+}
+
+// Return the entry of `node` to store its result in `env` to, replacing its
+// previous result if any, or else evicting the least recently used entry if
+// the cache is full.
+static Entry *insert(const ASTNode *node, const Env *env)
+{
+	Entry *e = *probe(node);
+	if (e) {
+		evict(e);
+		unlink_entry(e);
+	} else {
+		if (cache.len < cache.cap) {
+			e = &cache.ents[cache.len++];
+		} else {
+			e = cache.tail;
+			unlink_entry(e);
+			unslot(probe(e->node));
+			evict(e);
+			free(e->syms);
+		}
+		e->node = node;
+		e->syms = node_syms(node, &e->nsyms);
+		*probe(node) = e;
+	}
+	e->bound = bound(e, env);
+	link_entry(e);
+	return e;
+}
+
+// Enable the cache, holding up to `cap` results.
+void init_cache(int cap)
+{
+	if (cap <= 0) {
+		return;
+	}
+	cache.nslots = 1;
+	while (cache.nslots < 2UL * cap) {
+		cache.nslots *= 2;
+	}
+	cache.slots = calloc(cache.nslots, sizeof *cache.slots);
+	cache.ents = malloc(cap * sizeof *cache.ents);
+	cache.cap = cap;
+	pool_init(&cache.terms, sizeof(TermNode));
+}
+
+// Return the cached polynomial of `node` evaluated in `env`, or `NULL` if there
+// is none.
+TermNode *cached_poly(const ASTNode *node, const Env *env)
+{
+	Entry *e = find(node, env);
+	return e ? share_poly(e->u.poly) : NULL;
+}
+
+// Cache a copy of `p`, the polynomial of `node` evaluated in `env`.
+void cache_poly(const ASTNode *node, const Env *env, const TermNode *p)
+{
+	if (!cache.cap) {
+		return;
+	}
+	Entry *e = insert(node, env);
+	Pool *pool = term_pool;
+	term_pool = &cache.terms;
+	e->u.poly = poly_dup(p);
+	term_pool = pool;
+}
+
+// Return the cached relation of `node` evaluated in `env`, or `NULL` if there
+// is none. The nodes of the relation are allocated from `stmt_arena`, and share
+// their polynomials with the cache.
+RelNode *cached_rel(const ASTNode *node, const Env *env)
+{
+	Entry *e = find(node, env);
+	if (!e) {
+		return NULL;
+	}
+	RelNode *hd = NULL, **p = &hd;
+	for (const RelNode *r = e->u.rel; r; r = r->next) {
+		// An inconsistent system has no polynomials.
+		*p = rnode(r->rel, r->left ? share_poly(r->left) : NULL,
+			   r->right ? share_poly(r->right) : NULL);
+		p = &(*p)->next;
+	}
+	return hd;
+}
+
+// Cache a copy of `r`, the relation of `node` evaluated in `env`.
+void cache_rel(const ASTNode *node, const Env *env, const RelNode *r)
+{
+	if (!cache.cap) {
+		return;
+	}
+	Entry *e = insert(node, env);
+	Pool *pool = term_pool;
+	term_pool = &cache.terms;
+	RelNode **p = &e->u.rel;
+	for (; r; r = r->next) {
+		*p = malloc(sizeof **p);
+		**p = (RelNode){r->rel, r->left ? poly_dup(r->left) : NULL,
+				r->right ? poly_dup(r->right) : NULL, NULL};
+		p = &(*p)->next;
+	}
+	*p = NULL;
+	term_pool = pool;
+}
+
+// Release the results evicted during the statement just evaluated.
+void free_evicted(void)
+{
+	for (int i = 0; i < cache.nevicted; ++i) {
+		release(&cache.evicted[i]);
+	}
+	cache.nevicted = 0;
+}
+
+// Mark the nodes of the cached results to be kept by `collect_nodes`.
+void mark_cached(void)
+{
+	for (int i = 0; i < cache.len; ++i) {
+		mark_nodes(cache.ents[i].node);
+	}
+}
+
+// Print the number of cache hits and misses to `stderr`.
+void print_cache_stats(void)
+{
+	if (cache.cap) {
+		fprintf(stderr, "cache: %lu hits, %lu misses\n", cache.hits,
+			cache.misses);
+	}
+}
+
+// Release the cache.
+void free_cache(void)
+{
+	free_evicted();
+	free(cache.evicted);
+	for (int i = 0; i < cache.len; ++i) {
+		release(&cache.ents[i]);
+		free(cache.ents[i].syms);
+	}
+	free(cache.slots);
+	free(cache.ents);
+	free_pool(&cache.terms);
+	cache.cap = cache.len = 0;
+}
@@ -0,0 +1,48 @@
+#ifndef CACHE_H
+#define CACHE_H
+
+#include "ast.h"
+
+// A bounded cache of the results of evaluated statements, keyed by the root of
+// the hash-consed AST. As variables are never reassigned, a result stays valid
+// until one of the variables under its root is assigned, which is found by
+// counting those assigned. The least recently used entry is evicted once the
+// cache is full.
+
+struct TermNode;
+struct RelNode;
+struct Env;
+
+// Enable the cache, holding up to `cap` results.
+void init_cache(int cap);
+
+// Return the cached polynomial of `node` evaluated in `env`, or `NULL` if there
+// is none.
+struct TermNode *cached_poly(const ASTNode *node, const struct Env *env);
+
+// Cache a copy of `p`, the polynomial of `node` evaluated in `env`.
+void cache_poly(const ASTNode *node, const struct Env *env,
+		const struct TermNode *p);
+
+// Return the cached relation of `node` evaluated in `env`, or `NULL` if there
+// is none.
+struct RelNode *cached_rel(const ASTNode *node, const struct Env *env);
+
+// Cache a copy of `r`, the relation of `node` evaluated in `env`.
+void cache_rel(const ASTNode *node, const struct Env *env,
+	       const struct RelNode *r);
+
+// Release the results evicted during the statement just evaluated, which it
+// may have shared until its end.
+void free_evicted(void);
+
+// Mark the nodes of the cached results to be kept by `collect_nodes`.
+void mark_cached(void);
+
+// Print the number of cache hits and misses to `stderr`.
+void print_cache_stats(void);
+
+// Release the cache.
+void free_cache(void);
+
+#endif /* ifndef CACHE_H */
@@ -0,0 +1,438 @@
+#include "code.h"
+#include "asgn.h"
+#include "bigint.h"
+#include "coeff.h"
+#include "pool.h"
+#include "stats.h"
+#include "term.h"
+#include <stdio.h>
+#include <stdlib.h>
+
+typedef struct Insn {
+	enum Opcode {
+		LOAD_CONST, // r[a] = consts[b]
+		LOAD_VAR,   // r[a] = variable b
+		APPLY,	    // r[a] = r[b] op r[c], or op r[b] for `NEG`
+		MEMO,	    // r[a] = the memo of `node` if any, and go to b
+		STORE	    // Memoize r[a] as the result of `node`.
+	} code;
+	Op op;
+	int a, b;
+	union {
+		int c;
+		ASTNode *node; // Only the memo is modified.
+	} u;
+} Insn;
+
+typedef struct Program {
+	Insn *insns;
+	int len, cap;
+	struct TermNode **consts;
+	int nconsts, consts_cap;
+	int nregs;
+} Program;
+
+// Constants are only folded if their results have at most this many bits.
+#define FOLD_MAX_BITS 4096
+
+// Folded constants and memoized results, with the temporaries of the latter.
+// Programs own their constants, and share them with the registers loading them,
+// so that the registers never release their terms.
+static Pool terms;
+
+static int emit(Program *prog, Insn insn)
+{
+	if (prog->len == prog->cap) {
+		prog->cap = prog->cap ? 2 * prog->cap : 16;
+		prog->insns =
+		    realloc(prog->insns, prog->cap * sizeof *prog->insns);
+	}
+	prog->insns[prog->len] = insn;
+	return prog->len++;
+}
+
+// Emit loading the constant `p` into register `reg`; `p` is owned by `prog`.
+static void emit_const(Program *prog, int reg, TermNode *p)
+{
+	if (prog->nconsts == prog->consts_cap) {
+		prog->consts_cap = prog->consts_cap ? 2 * prog->consts_cap : 4;
+		prog->consts = realloc(prog->consts,
+				       prog->consts_cap * sizeof *prog->consts);
+	}
+	prog->consts[prog->nconsts] = p;
+	emit(prog, (Insn){LOAD_CONST, .a = reg, .b = prog->nconsts++});
+}
+
+// Return the result of applying `op` to `lt` and `rt`, which are consumed, or
+// `NULL` if the operation fails. `rt` is `NULL` for `NEG`.
+static TermNode *apply(Op op, TermNode *lt, TermNode *rt)
+{
+	// An operand being `NULL` indicates an invalid syntax or an operation,
+	// except for the right operand of the `NEG` op.
+	if (!lt || (!rt && op != NEG)) {
+		free_poly(lt);
+		free_poly(rt);
+		return NULL;
+	}
+
+	long start = stats ? stats_clock() : 0;
+	bool success;
+	switch (op) {
+	case ADD:
+		success = add_poly(&lt, rt);
+		break;
+	case SUB:
+		success = sub_poly(&lt, rt);
+		break;
+	case MUL:
+		success = mul_poly(&lt, rt);
+		break;
+	case DIV:
+		success = div_poly(&lt, rt);
+		break;
+	case POW:
+		success = pow_poly(&lt, rt);
+		break;
+	case NEG:
+		success = neg_poly(&lt);
+		break;
+	default:
+		fprintf(stderr, "unknown op type %d\n", op);
+		abort();
+	}
+	if (stats) {
+		stmt_stats.op_ns[op] += stats_clock() - start;
+	}
+	if (!success) {
+		free_poly(lt);
+		return NULL;
+	}
+	return lt;
+}
+
+// A node being compiled by `compile`, whose operands are compiled first.
+typedef struct Frame {
+	ASTNode *node; // Only the memo is modified.
+	int reg;       // Register its result is stored to
+	bool expanded; // Whether its operands have been pushed
+	int memo;      // Its `MEMO` instruction
+} Frame;
+
+// A compiled operand: a constant not loaded yet, or stored to `reg` by the
+// instructions emitted for it if `val` is `NULL`.
+typedef struct Operand {
+	TermNode *val;
+	int reg;
+} Operand;
+
+// The nodes pending and the operands compiled so far.
+typedef struct CompileStack {
+	Frame *frames;
+	Operand *vals;
+	int nframes, nvals, frames_cap, vals_cap;
+} CompileStack;
+
+static void push_frame(CompileStack *st, const ASTNode *node, int reg)
+{
+	if (st->nframes == st->frames_cap) {
+		st->frames_cap = st->frames_cap ? 2 * st->frames_cap : 64;
+		st->frames =
+		    realloc(st->frames, st->frames_cap * sizeof *st->frames);
+	}
+	st->frames[st->nframes++] =
+	    (Frame){.node = (ASTNode *)node, .reg = reg};
+}
+
+static void push_val(CompileStack *st, TermNode *val, int reg)
+{
+	if (st->nvals == st->vals_cap) {
+		st->vals_cap = st->vals_cap ? 2 * st->vals_cap : 64;
+		st->vals = realloc(st->vals, st->vals_cap * sizeof *st->vals);
+	}
+	st->vals[st->nvals++] = (Operand){val, reg};
+}
+
+// Emit loading `v` into its register if it is a constant.
+static void load(Program *prog, Operand v)
+{
+	if (v.val) {
+		emit_const(prog, v.reg, v.val);
+	}
+}
+
+// Whether applying `op` to the constants `lt` and `rt` can be folded, i.e.,
+// succeeds, and its result is small enough to be computed while compiling.
+// Operations on numbers fail only when dividing by zero. Larger constants are
+// left to be computed when the program is run.
+static bool foldable(Op op, const TermNode *lt, const TermNode *rt)
+{
+	if (!lt || (op != NEG && !rt)) {
+		return false;
+	}
+	Coeff l = coeff_of(lt);
+	Coeff r = rt ? coeff_of(rt) : (Coeff){ICOEFF_TERM, .hd.ival = 1};
+	long lbits = coeff_bits(&l), rbits = coeff_bits(&r);
+	switch (op) {
+	case DIV:
+		return !coeff_zero(&r) && lbits + rbits <= FOLD_MAX_BITS;
+	case POW:
+		if (r.type == ICOEFF_TERM && lbits > 1) {
+			long k = FOLD_MAX_BITS / lbits;
+			return r.hd.ival >= -k && r.hd.ival <= k;
+		}
+		return true;
+	default:
+		return lbits + rbits <= FOLD_MAX_BITS;
+	}
+}
+
+// Compile the expression `node`, unless it is already compiled.
+// The result of an `OP_NODE` is stored to the register of its left operand,
+// and the right operand takes the next register. The root and the nodes shared
+// with other expressions, if not constant, are preceded by a `MEMO` and
+// followed by a `STORE`, which reuse or make the memo of the node if it has
+// been constructed more than once by the time it is run. The tree is walked
+// with explicit stacks, so that arbitrarily deep trees take no native stack.
+void compile(ASTNode *node)
+{
+	if (node->code) {
+		return;
+	}
+	if (!terms.size) {
+		pool_init(&terms, sizeof(TermNode));
+	}
+	Pool *pool = term_pool;
+	term_pool = &terms;
+
+	Program *prog = calloc(1, sizeof *prog);
+	CompileStack st = {NULL, NULL, 0, 0, 0, 0};
+	push_frame(&st, node, 0);
+	while (st.nframes) {
+		Frame *f = &st.frames[st.nframes - 1];
+		const ASTNode *n = f->node;
+		int reg = f->reg;
+		if (reg >= prog->nregs) {
+			prog->nregs = reg + 1;
+		}
+		switch (n->type) {
+		case INUM_NODE:
+			--st.nframes;
+			push_val(&st, icoeff_term(n->u.ival), reg);
+			continue;
+		case BNUM_NODE: {
+			--st.nframes;
+			Coeff c = {BCOEFF_TERM, .hd.big = big_dup(n->u.big)};
+			push_val(&st, coeff_term(&c), reg);
+			continue;
+		}
+		case RNUM_NODE:
+			--st.nframes;
+			push_val(&st, rcoeff_term(n->u.rval), reg);
+			continue;
+		case VAR_NODE:
+			--st.nframes;
+			emit(prog, (Insn){LOAD_VAR, .a = reg, .b = n->u.sym});
+			push_val(&st, NULL, reg);
+			continue;
+		case OP_NODE:
+			break;
+		default:
+			fprintf(stderr, "unexpected node type %d\n", n->type);
+			abort();
+		}
+
+		Op op = n->u.opdat.op;
+		if (!f->expanded) {
+			f->expanded = true;
+			f->memo = -1;
+			if (n == node || n->uses >= 2) {
+				f->memo = emit(prog, (Insn){MEMO, .a = reg});
+			}
+			// `f` is invalidated by pushing, and operands are
+			// compiled from left to right.
+			if (op != NEG) {
+				push_frame(&st, n->u.opdat.right, reg + 1);
+			}
+			push_frame(&st, n->u.opdat.left, reg);
+			continue;
+		}
+
+		Operand rt = {NULL, -1};
+		if (op != NEG) {
+			rt = st.vals[--st.nvals];
+		}
+		Operand lt = st.vals[--st.nvals];
+		if (foldable(op, lt.val, rt.val)) {
+			// Nothing but the `MEMO` of `n` has been emitted since.
+			if (f->memo >= 0) {
+				prog->len = f->memo;
+			}
+			push_val(&st, apply(op, lt.val, rt.val), reg);
+		} else {
+			load(prog, lt);
+			load(prog, rt);
+			emit(prog, (Insn){APPLY, op, reg, lt.reg, {rt.reg}});
+			if (f->memo >= 0) {
+				Insn store = {STORE, .a = reg};
+				store.u.node = f->node;
+				emit(prog, store);
+				prog->insns[f->memo].b = prog->len;
+				prog->insns[f->memo].u.node = f->node;
+			}
+			push_val(&st, NULL, reg);
+		}
+		--st.nframes;
+	}
+	load(prog, st.vals[0]);
+	free(st.frames);
+	free(st.vals);
+	prog->insns = realloc(prog->insns, prog->len * sizeof *prog->insns);
+
+	term_pool = pool;
+	node->code = prog;
+}
+
+// Return the polynomial of variable `sym`.
+static TermNode *load_var(int sym, const Env *env)
+{
+	TermNode *p;
+	// Check if there is already a term assigned to `sym` in `env`.
+	if ((p = lookup(sym, env))) {
+		return share_poly(p);
+	} else {
+		p = icoeff_term(1);
+		TermNode *vt = var_term(sym, 1);
+		p->u.vars = vt;
+		return p;
+	}
+}
+
+// Nodes memoized by the current statement, whose memos are released at its end.
+static struct {
+	ASTNode **nodes;
+	int len, cap;
+} memoized;
+
+// Return the resulting polynomial running the program of `node`, which must be
+// compiled.
+// Memoized results and their temporaries are allocated from `terms`; a memo is
+// shared with the expressions using it, so they never release its terms, and
+// memos only last until `free_memos` at the end of the statement.
+TermNode *run(const ASTNode *node, const Env *env)
+{
+	const Program *prog = node->code;
+	TermNode *local[16];
+	TermNode **r = prog->nregs <= 16 ? local
+					 : malloc(prog->nregs * sizeof *r);
+	r[0] = NULL;
+	Pool **pools = NULL; // Pools to return to once the memos are made
+	int npools = 0, pools_cap = 0;
+	for (int pc = 0; pc < prog->len; ++pc) {
+		const Insn *i = &prog->insns[pc];
+		ASTNode *n = i->u.node;
+		switch (i->code) {
+		case LOAD_CONST:
+			r[i->a] = share_poly(prog->consts[i->b]);
+			break;
+		case LOAD_VAR:
+			r[i->a] = load_var(i->b, env);
+			break;
+		case APPLY:
+			r[i->a] = apply(i->op, r[i->b],
+					i->op == NEG ? NULL : r[i->u.c]);
+			break;
+		case MEMO:
+			if (!memoize || n->uses < 2) {
+				break;
+			}
+			if (n->memo) {
+				r[i->a] = share_poly(n->memo);
+				pc = i->b - 1;
+				break;
+			}
+			if (npools == pools_cap) {
+				pools_cap = pools_cap ? 2 * pools_cap : 16;
+				pools = realloc(pools,
+						pools_cap * sizeof *pools);
+			}
+			pools[npools++] = term_pool;
+			term_pool = &terms;
+			break;
+		case STORE: {
+			if (!memoize || n->uses < 2) {
+				break;
+			}
+			TermNode *p = r[i->a];
+			n->memo = p;
+			if (memoized.len == memoized.cap) {
+				memoized.cap =
+				    memoized.cap ? 2 * memoized.cap : 16;
+				memoized.nodes = realloc(
+				    memoized.nodes,
+				    memoized.cap * sizeof *memoized.nodes);
+			}
+			memoized.nodes[memoized.len++] = n;
+			term_pool = pools[--npools];
+			if (p) {
+				r[i->a] = share_poly(p);
+			}
+			break;
+		}
+		default:
+			fprintf(stderr, "unexpected opcode %d\n", i->code);
+			abort();
+		}
+	}
+	TermNode *p = r[0];
+	if (r != local) {
+		free(r);
+	}
+	free(pools);
+	return p;
+}
+
+// Release the program and the memo of `node`.
+void free_code(ASTNode *node)
+{
+	Pool *pool = term_pool;
+	term_pool = &terms;
+	free_poly(node->memo);
+	node->memo = NULL;
+	Program *prog = node->code;
+	if (prog) {
+		for (int i = 0; i < prog->nconsts; ++i) {
+			free_poly(prog->consts[i]);
+		}
+		free(prog->consts);
+		free(prog->insns);
+		free(prog);
+		node->code = NULL;
+	}
+	term_pool = pool;
+}
+
+// Release the memos made by the current statement.
+void free_memos(void)
+{
+	Pool *pool = term_pool;
+	term_pool = &terms;
+	for (int i = 0; i < memoized.len; ++i) {
+		free_poly(memoized.nodes[i]->memo);
+		memoized.nodes[i]->memo = NULL;
+	}
+	memoized.len = 0;
+	term_pool = pool;
+}
+
+// Release the memory held for the programs and the memos, once every node is
+// released by `free_code`.
+void free_codes(void)
+{
+	free(memoized.nodes);
+	memoized.nodes = NULL;
+	memoized.len = memoized.cap = 0;
+	if (terms.size) {
+		free_pool(&terms);
+		terms.size = 0;
+	}
+}
@@ -0,0 +1,33 @@
+#ifndef CODE_H
+#define CODE_H
+
+#include "ast.h"
+
+// Expressions are compiled into programs for a register machine before they are
+// evaluated. An instruction loads a constant or a variable into a register, or
+// applies an operation to registers, and a program leaves its result in
+// register 0. Constant subexpressions are folded at compile time. A program is
+// kept in the root node of its expression, and so is reused by every statement
+// evaluating an equal expression, in whatever environment.
+
+struct TermNode;
+struct Env;
+
+// Compile the expression `node`, unless it is already compiled.
+void compile(ASTNode *node);
+
+// Return the resulting polynomial running the program of `node`, which must be
+// compiled.
+struct TermNode *run(const ASTNode *node, const struct Env *env);
+
+// Release the program and the memo of `node`.
+void free_code(ASTNode *node);
+
+// Release the memos made by the current statement.
+void free_memos(void);
+
+// Release the memory held for the programs and the memos, once every node is
+// released by `free_code`.
+void free_codes(void);
+
+#endif /* ifndef CODE_H */
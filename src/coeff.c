@@ -0,0 +1,525 @@
+#include "coeff.h"
+#include "bigint.h"
+#include "out.h"
+#include "util.h"
+#include <limits.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <tgmath.h>
+
+// Coefficients are kept in the narrowest type holding their value, i.e., a
+// `BCOEFF_TERM` never fits in a `long`, and a `QCOEFF_TERM` is never an
+// integer. Operations on `ICOEFF_TERM`s are checked for overflow and only fall
+// back to `BigInt`s when needed, and rationals are only involved once a
+// division is inexact. An operation involving an `RCOEFF_TERM` is carried out
+// in `double`.
+
+// Exponentiations whose result would have more bits than this are carried out
+// in `double` instead.
+#define IPOW_MAX_BITS (1L << 18)
+
+static double to_double(const Coeff *c)
+{
+	switch (c->type) {
+	case ICOEFF_TERM:
+		return c->hd.ival;
+	case RCOEFF_TERM:
+		return c->hd.rval;
+	case BCOEFF_TERM:
+		return big_to_double(c->hd.big);
+	case QCOEFF_TERM:
+		return to_double(&c->hd.rat->num) / to_double(&c->hd.rat->den);
+	default:
+		fprintf(stderr, "unexpected node type %d\n", c->type);
+		abort();
+	}
+}
+
+static bool is_int(const Coeff *c)
+{
+	return c->type == ICOEFF_TERM || c->type == BCOEFF_TERM;
+}
+
+// Return the numerator of an exact coefficient `c`, still owned by `c`.
+static Coeff num_of(const Coeff *c)
+{
+	return c->type == QCOEFF_TERM ? c->hd.rat->num : *c;
+}
+
+// Return the denominator of an exact coefficient `c`, still owned by `c`.
+static Coeff den_of(const Coeff *c)
+{
+	if (c->type == QCOEFF_TERM) {
+		return c->hd.rat->den;
+	}
+	return (Coeff){ICOEFF_TERM, .hd.ival = 1};
+}
+
+// Return the value of an integer coefficient `c` as a `BigInt`, which is
+// allocated unless `c` is a `BCOEFF_TERM` already. Release it with `drop_big`.
+static BigInt *as_big(const Coeff *c)
+{
+	switch (c->type) {
+	case ICOEFF_TERM:
+		return big_from_long(c->hd.ival);
+	case BCOEFF_TERM:
+		return c->hd.big;
+	default:
+		fprintf(stderr, "unexpected node type %d\n", c->type);
+		abort();
+	}
+}
+
+static void drop_big(const Coeff *c, BigInt *b)
+{
+	if (c->type != BCOEFF_TERM) {
+		free(b);
+	}
+}
+
+// Set `c`, whose previous value has been released, to `b`.
+static void set_big(Coeff *c, BigInt *b)
+{
+	long v;
+	if (big_to_long(b, &v)) {
+		free(b);
+		*c = (Coeff){ICOEFF_TERM, .hd.ival = v};
+	} else {
+		*c = (Coeff){BCOEFF_TERM, .hd.big = b};
+	}
+}
+
+// Set `c` to `d`, releasing the previous value of `c`.
+static void set_double(Coeff *c, double d)
+{
+	free_coeff(c);
+	*c = (Coeff){RCOEFF_TERM, .hd.rval = d};
+}
+
+static BigInt *big_quo(const BigInt *a, const BigInt *b)
+{
+	return big_divmod(a, b, NULL);
+}
+
+// Apply `op` to integer coefficients `dest` and `src` as `BigInt`s.
+// `src` may alias `dest`.
+static void big_op(Coeff *dest, const Coeff *src,
+		   BigInt *(*op)(const BigInt *, const BigInt *))
+{
+	BigInt *a = as_big(dest);
+	BigInt *b = as_big(src);
+	BigInt *r = op(a, b);
+	if (b != a) {
+		drop_big(src, b);
+	}
+	free(a); // Either a temporary or the previous value of `dest`.
+	set_big(dest, r);
+}
+
+// Divide an integer coefficient `dest` by `src`, which divides it exactly.
+static void int_quo(Coeff *dest, const Coeff *src)
+{
+	if (dest->type == ICOEFF_TERM && src->type == ICOEFF_TERM &&
+	    src->hd.ival != -1) { // LONG_MIN / -1 overflows.
+		dest->hd.ival /= src->hd.ival;
+	} else {
+		big_op(dest, src, big_quo);
+	}
+}
+
+// Set an integer coefficient `dest` to the greatest common divisor of `dest`
+// and `src`.
+static void int_gcd(Coeff *dest, const Coeff *src)
+{
+	if (dest->type == ICOEFF_TERM && src->type == ICOEFF_TERM &&
+	    dest->hd.ival != LONG_MIN && src->hd.ival != LONG_MIN) {
+		dest->hd.ival = gcd(labs(dest->hd.ival), labs(src->hd.ival));
+		return;
+	}
+	// Euclid's algorithm on copies, which are consumed by the loop.
+	BigInt *a = as_big(dest), *b = as_big(src);
+	BigInt *x = big_dup(a), *y = big_dup(b);
+	if (b != a) {
+		drop_big(src, b);
+	}
+	free(a);
+	while (big_sgn(y)) {
+		BigInt *r;
+		free(big_divmod(x, y, &r));
+		free(x);
+		x = y;
+		y = r;
+	}
+	free(y);
+	if (x->neg) {
+		big_neg(x);
+	}
+	set_big(dest, x);
+}
+
+// Set `c`, whose previous value has been released, to `n / d`, taking over the
+// integer coefficients `n` and `d`. `d` must be non-zero.
+// The fraction is reduced to lowest terms with a positive denominator, and
+// demoted to an integer if the denominator is 1.
+static void set_rat(Coeff *c, Coeff n, Coeff d)
+{
+	Coeff g = coeff_dup(&n);
+	int_gcd(&g, &d);
+	if (coeff_sgn(&d) < 0) {
+		coeff_neg(&g);
+	}
+	if (g.type != ICOEFF_TERM || g.hd.ival != 1) {
+		int_quo(&n, &g);
+		int_quo(&d, &g);
+	}
+	free_coeff(&g);
+	if (d.type == ICOEFF_TERM && d.hd.ival == 1) {
+		*c = n;
+		return;
+	}
+	Rat *q = malloc(sizeof *q);
+	*q = (Rat){n, d};
+	*c = (Coeff){QCOEFF_TERM, .hd.rat = q};
+}
+
+// Set `dest` to `(n1 * d2 + n2 * d1) / (d1 * d2)` if `add`, or to
+// `(n1 * n2) / (d1 * d2)` otherwise, where `n1 / d1` and `n2 / d2` are the
+// exact coefficients `dest` and `src`.
+static void rat_op(Coeff *dest, const Coeff *src, bool add)
+{
+	Coeff n1 = num_of(dest), d1 = den_of(dest);
+	Coeff n2 = num_of(src), d2 = den_of(src);
+	Coeff n = coeff_dup(&n1), d = coeff_dup(&d1);
+	if (add) {
+		Coeff t = coeff_dup(&n2);
+		coeff_mul(&n, &d2);
+		coeff_mul(&t, &d1);
+		coeff_add(&n, &t);
+		free_coeff(&t);
+	} else {
+		coeff_mul(&n, &n2);
+	}
+	coeff_mul(&d, &d2);
+	free_coeff(dest);
+	set_rat(dest, n, d);
+}
+
+// Set an exact non-zero coefficient `c` to its reciprocal.
+static void inv(Coeff *c)
+{
+	Coeff n = num_of(c), d = den_of(c);
+	n = coeff_dup(&n);
+	d = coeff_dup(&d);
+	free_coeff(c);
+	set_rat(c, d, n);
+}
+
+// Compare the values of `c1` and `c2`.
+int cmp_coeff(const Coeff *c1, const Coeff *c2)
+{
+	if (c1->type == ICOEFF_TERM && c2->type == ICOEFF_TERM) {
+		return ncmp(c1->hd.ival, c2->hd.ival);
+	}
+	if (c1->type == RCOEFF_TERM || c2->type == RCOEFF_TERM) {
+		if (c1->type == ICOEFF_TERM) {
+			return ncmp(c1->hd.ival, c2->hd.rval);
+		} else if (c2->type == ICOEFF_TERM) {
+			return ncmp(c1->hd.rval, c2->hd.ival);
+		}
+		return ncmp(to_double(c1), to_double(c2));
+	}
+	if (!is_int(c1) || !is_int(c2)) {
+		// Denominators are positive, so compare `n1 * d2` to `n2 * d1`.
+		Coeff n1 = num_of(c1), d1 = den_of(c1);
+		Coeff n2 = num_of(c2), d2 = den_of(c2);
+		Coeff t1 = coeff_dup(&n1), t2 = coeff_dup(&n2);
+		coeff_mul(&t1, &d2);
+		coeff_mul(&t2, &d1);
+		int cmp = cmp_coeff(&t1, &t2);
+		free_coeff(&t1);
+		free_coeff(&t2);
+		return cmp;
+	}
+	BigInt *a = as_big(c1), *b = as_big(c2);
+	int cmp = big_cmp(a, b);
+	drop_big(c1, a);
+	drop_big(c2, b);
+	return cmp;
+}
+
+double coeff_double(const Coeff *c) { return to_double(c); }
+
+// Return a hash of the value of `c`, equal for values equal by `cmp_coeff`.
+// A real is equal to an exact coefficient converted to it, so all values are
+// hashed as `double`s.
+unsigned long coeff_hash(const Coeff *c)
+{
+	double d = to_double(c) + 0.0; // No negative zero
+	unsigned long h = 0;
+	memcpy(&h, &d, sizeof d < sizeof h ? sizeof d : sizeof h);
+	return h;
+}
+
+// Add `src` to `dest`.
+void coeff_add(Coeff *dest, const Coeff *src)
+{
+	long v;
+	if (dest->type == ICOEFF_TERM && src->type == ICOEFF_TERM &&
+	    !__builtin_add_overflow(dest->hd.ival, src->hd.ival, &v)) {
+		dest->hd.ival = v;
+	} else if (dest->type == RCOEFF_TERM || src->type == RCOEFF_TERM) {
+		set_double(dest, to_double(dest) + to_double(src));
+	} else if (is_int(dest) && is_int(src)) {
+		big_op(dest, src, big_add);
+	} else {
+		rat_op(dest, src, true);
+	}
+}
+
+// Multiply `src` to `dest`.
+void coeff_mul(Coeff *dest, const Coeff *src)
+{
+	long v;
+	if (dest->type == ICOEFF_TERM && src->type == ICOEFF_TERM &&
+	    !__builtin_mul_overflow(dest->hd.ival, src->hd.ival, &v)) {
+		dest->hd.ival = v;
+	} else if (dest->type == RCOEFF_TERM || src->type == RCOEFF_TERM) {
+		set_double(dest, to_double(dest) * to_double(src));
+	} else if (is_int(dest) && is_int(src)) {
+		big_op(dest, src, big_mul);
+	} else {
+		rat_op(dest, src, false);
+	}
+}
+
+// Add the product of `c1` and `c2` to `dest`.
+void coeff_addmul(Coeff *dest, const Coeff *c1, const Coeff *c2)
+{
+	long p, v;
+	if (dest->type == ICOEFF_TERM && c1->type == ICOEFF_TERM &&
+	    c2->type == ICOEFF_TERM &&
+	    !__builtin_mul_overflow(c1->hd.ival, c2->hd.ival, &p) &&
+	    !__builtin_add_overflow(dest->hd.ival, p, &v)) {
+		dest->hd.ival = v;
+		return;
+	}
+	Coeff prod = coeff_dup(c1);
+	coeff_mul(&prod, c2);
+	coeff_add(dest, &prod);
+	free_coeff(&prod);
+}
+
+// Divide `dest` by `src`. `src` should be guaranteed to be non-zero.
+// The quotient of exact coefficients is exact, being a rational if needed.
+void coeff_div(Coeff *dest, const Coeff *src)
+{
+	if (dest->type == RCOEFF_TERM || src->type == RCOEFF_TERM) {
+		set_double(dest, to_double(dest) / to_double(src));
+	} else if (dest->type == ICOEFF_TERM && src->type == ICOEFF_TERM &&
+		   src->hd.ival != -1 && !(dest->hd.ival % src->hd.ival)) {
+		dest->hd.ival /= src->hd.ival;
+	} else {
+		// n1 / d1 / (n2 / d2) = (n1 * d2) / (d1 * n2)
+		Coeff n1 = num_of(dest), d1 = den_of(dest);
+		Coeff n2 = num_of(src), d2 = den_of(src);
+		Coeff n = coeff_dup(&n1), d = coeff_dup(&d1);
+		coeff_mul(&n, &d2);
+		coeff_mul(&d, &n2);
+		free_coeff(dest);
+		set_rat(dest, n, d);
+	}
+}
+
+// Return the number of bits of the magnitude of an exact coefficient `c`, or of
+// its numerator or denominator, whichever is longer, or 0 if `c` is inexact.
+long coeff_bits(const Coeff *c)
+{
+	if (c->type == RCOEFF_TERM) {
+		return 0;
+	}
+	if (c->type == QCOEFF_TERM) {
+		long n = coeff_bits(&c->hd.rat->num);
+		long d = coeff_bits(&c->hd.rat->den);
+		return n > d ? n : d;
+	}
+	if (c->type == ICOEFF_TERM) {
+		unsigned long m = c->hd.ival < 0 ? -(unsigned long)c->hd.ival
+						 : (unsigned long)c->hd.ival;
+		return m ? 64 - __builtin_clzl(m) : 0;
+	}
+	return 32 * (long)c->hd.big->len;
+}
+
+// Exponentiate `dest` to the power of `src`.
+// An exact coefficient raised to an integer is computed exactly.
+void coeff_pow(Coeff *dest, const Coeff *src)
+{
+	// Keep to non-negative exponents unless `dest` has a reciprocal.
+	if (dest->type != RCOEFF_TERM && src->type == ICOEFF_TERM &&
+	    src->hd.ival != LONG_MIN &&
+	    (src->hd.ival >= 0 || !coeff_zero(dest))) {
+		long e = src->hd.ival, k = labs(e);
+		long bits = coeff_bits(dest);
+		if (bits <= 1 || k <= IPOW_MAX_BITS / bits) {
+			if (e < 0) {
+				inv(dest);
+			}
+			coeff_ipow(dest, k);
+			return;
+		}
+	}
+	set_double(dest, pow(to_double(dest), to_double(src)));
+}
+
+// Raise `c` to the power of `k`, a non-negative integer, by squaring.
+void coeff_ipow(Coeff *c, long k)
+{
+	if (c->type == QCOEFF_TERM && k) {
+		// Powers of coprime integers stay coprime.
+		coeff_ipow(&c->hd.rat->num, k);
+		coeff_ipow(&c->hd.rat->den, k);
+		return;
+	}
+	Coeff base = *c;
+	*c = (Coeff){ICOEFF_TERM, .hd.ival = 1};
+	while (k) {
+		if (k % 2) {
+			coeff_mul(c, &base);
+		}
+		if ((k /= 2)) {
+			coeff_mul(&base, &base);
+		}
+	}
+	free_coeff(&base);
+}
+
+// Negate `c`.
+void coeff_neg(Coeff *c)
+{
+	switch (c->type) {
+	case ICOEFF_TERM:
+		if (c->hd.ival == LONG_MIN) {
+			BigInt *b = big_from_long(c->hd.ival);
+			big_neg(b);
+			set_big(c, b);
+		} else {
+			c->hd.ival = -c->hd.ival;
+		}
+		return;
+	case RCOEFF_TERM:
+		c->hd.rval = -c->hd.rval;
+		return;
+	case BCOEFF_TERM:
+		// The negation of -LONG_MIN fits in a `long`.
+		big_neg(c->hd.big);
+		set_big(c, c->hd.big);
+		return;
+	case QCOEFF_TERM:
+		coeff_neg(&c->hd.rat->num);
+		return;
+	default:
+		fprintf(stderr, "unexpected node type %d\n", c->type);
+		abort();
+	}
+}
+
+// Check if `c` is zero.
+bool coeff_zero(const Coeff *c)
+{
+	return (c->type == ICOEFF_TERM && c->hd.ival == 0) ||
+	       (c->type == RCOEFF_TERM && c->hd.rval == 0);
+}
+
+// Return the sign of `c`: -1, 0 or 1.
+int coeff_sgn(const Coeff *c)
+{
+	switch (c->type) {
+	case ICOEFF_TERM:
+		return (c->hd.ival > 0) - (c->hd.ival < 0);
+	case RCOEFF_TERM:
+		return (c->hd.rval > 0) - (c->hd.rval < 0);
+	case BCOEFF_TERM:
+		return big_sgn(c->hd.big);
+	case QCOEFF_TERM:
+		return coeff_sgn(&c->hd.rat->num);
+	default:
+		fprintf(stderr, "unexpected node type %d\n", c->type);
+		abort();
+	}
+}
+
+// Set `dest` to the greatest common divisor of exact coefficients `dest` and
+// `src`, i.e., the largest rational dividing both into integers, which is
+// non-negative.
+void coeff_gcd(Coeff *dest, const Coeff *src)
+{
+	if (is_int(dest) && is_int(src)) {
+		int_gcd(dest, src);
+		return;
+	}
+	// gcd(n1 / d1, n2 / d2) = gcd(n1, n2) / lcm(d1, d2)
+	Coeff n1 = num_of(dest), d1 = den_of(dest);
+	Coeff n2 = num_of(src), d2 = den_of(src);
+	Coeff n = coeff_dup(&n1), d = coeff_dup(&d1), g = coeff_dup(&d1);
+	int_gcd(&n, &n2);
+	int_gcd(&g, &d2);
+	int_quo(&d, &g);
+	coeff_mul(&d, &d2);
+	free_coeff(&g);
+	free_coeff(dest);
+	set_rat(dest, n, d);
+}
+
+// Duplicate `c`.
+Coeff coeff_dup(const Coeff *c)
+{
+	if (c->type == BCOEFF_TERM) {
+		return (Coeff){BCOEFF_TERM, .hd.big = big_dup(c->hd.big)};
+	} else if (c->type == QCOEFF_TERM) {
+		Rat *q = malloc(sizeof *q);
+		*q = (Rat){coeff_dup(&c->hd.rat->num),
+			   coeff_dup(&c->hd.rat->den)};
+		return (Coeff){QCOEFF_TERM, .hd.rat = q};
+	}
+	return *c;
+}
+
+// Release the value of `c`.
+void free_coeff(Coeff *c)
+{
+	if (c->type == BCOEFF_TERM) {
+		free(c->hd.big);
+	} else if (c->type == QCOEFF_TERM) {
+		free_coeff(&c->hd.rat->num);
+		free_coeff(&c->hd.rat->den);
+		free(c->hd.rat);
+	}
+}
+
+// Print the value of `c`.
+void print_coeff(const Coeff *c)
+{
+	char *s;
+	switch (c->type) {
+	case ICOEFF_TERM:
+		out_long(c->hd.ival);
+		break;
+	case RCOEFF_TERM:
+		out_double(c->hd.rval);
+		break;
+	case BCOEFF_TERM:
+		s = big_str(c->hd.big);
+		out_str(s);
+		free(s);
+		break;
+	case QCOEFF_TERM:
+		print_coeff(&c->hd.rat->num);
+		out_char('/');
+		print_coeff(&c->hd.rat->den);
+		break;
+	default:
+		fprintf(stderr, "unexpected node type %d\n", c->type);
+		abort();
+	}
+}
@@ -0,0 +1,74 @@
+#ifndef COEFF_H
+#define COEFF_H
+
+#include "term.h"
+#include <stdbool.h>
+
+// A rational number `num / den` in lowest terms, where `num` and `den` are
+// integer coefficients and `den` is greater than 1.
+typedef struct Rat {
+	Coeff num, den;
+} Rat;
+
+// Arithmetic on `Coeff`s, shared by `TermNode` lists and `PolyVec`s.
+// A `Coeff` owns its value: assigning one to another moves the value, and
+// `coeff_dup` makes a copy. Operations storing to `dest` release its previous
+// value. Coefficients other than `RCOEFF_TERM`s are exact.
+
+// Compare the values of `c1` and `c2`.
+int cmp_coeff(const Coeff *c1, const Coeff *c2);
+
+// Return the value of `c` as a `double`, which may be inexact.
+double coeff_double(const Coeff *c);
+
+// Return a hash of the value of `c`, equal for values equal by `cmp_coeff`.
+unsigned long coeff_hash(const Coeff *c);
+
+// Add `src` to `dest`.
+void coeff_add(Coeff *dest, const Coeff *src);
+
+// Multiply `src` to `dest`.
+void coeff_mul(Coeff *dest, const Coeff *src);
+
+// Add the product of `c1` and `c2` to `dest`.
+void coeff_addmul(Coeff *dest, const Coeff *c1, const Coeff *c2);
+
+// Divide `dest` by `src`. `src` should be guaranteed to be non-zero.
+// The quotient of exact coefficients is exact, being a rational if needed.
+void coeff_div(Coeff *dest, const Coeff *src);
+
+// Exponentiate `dest` to the power of `src`.
+// An exact coefficient raised to an integer is computed exactly.
+void coeff_pow(Coeff *dest, const Coeff *src);
+
+// Raise `c` to the power of `k`, a non-negative integer, by squaring.
+void coeff_ipow(Coeff *c, long k);
+
+// Negate `c`.
+void coeff_neg(Coeff *c);
+
+// Return the number of bits of the magnitude of an exact coefficient `c`, or of
+// its numerator or denominator, whichever is longer, or 0 if `c` is inexact.
+long coeff_bits(const Coeff *c);
+
+// Check if `c` is zero.
+bool coeff_zero(const Coeff *c);
+
+// Return the sign of `c`: -1, 0 or 1.
+int coeff_sgn(const Coeff *c);
+
+// Set `dest` to the greatest common divisor of exact coefficients `dest` and
+// `src`, i.e., the largest rational dividing both into integers, which is
+// non-negative.
+void coeff_gcd(Coeff *dest, const Coeff *src);
+
+// Duplicate `c`.
+Coeff coeff_dup(const Coeff *c);
+
+// Release the value of `c`.
+void free_coeff(Coeff *c);
+
+// Print the value of `c`.
+void print_coeff(const Coeff *c);
+
+#endif /* ifndef COEFF_H */
@@ -0,0 +1,418 @@
+#define _POSIX_C_SOURCE 200809L // getline, fdopen, pread, strndup
+#include "eval.h"
+#include "coeff.h"
+#include "out.h"
+#include "sym.h"
+#include "term.h"
+#include <ctype.h>
+#include <fcntl.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#define MAGIC "POLYTAB1"
+#define WORD sizeof(uint64_t)
+
+// Rows are evaluated a block at a time, so that the powers and the partial
+// products of a block stay in cache. The loops over a block are simple enough
+// for the compiler to vectorize.
+#define BLOCK 256
+
+// Add a column named `name` to `t`. Return false if `t` has one already.
+static bool add_col(Table *t, const char *name)
+{
+	int sym = intern(name);
+	for (int i = 0; i < t->ncols; ++i) {
+		if (t->syms[i] == sym) {
+			return false;
+		}
+	}
+	t->syms = realloc(t->syms, (t->ncols + 1) * sizeof *t->syms);
+	t->cols = realloc(t->cols, (t->ncols + 1) * sizeof *t->cols);
+	t->syms[t->ncols] = sym;
+	t->cols[t->ncols++] = NULL;
+	return true;
+}
+
+// Return `s` without its leading and trailing white spaces.
+static char *trim(char *s)
+{
+	while (isspace((unsigned char)*s)) {
+		++s;
+	}
+	char *end = s + strlen(s);
+	while (end > s && isspace((unsigned char)end[-1])) {
+		--end;
+	}
+	*end = '\0';
+	return s;
+}
+
+static bool read_csv(Table *t, FILE *f)
+{
+	char *line = NULL;
+	size_t n = 0;
+	bool ok = getline(&line, &n, f) > 0;
+	for (char *s = line, *comma; ok; s = comma + 1) {
+		if ((comma = strchr(s, ','))) {
+			*comma = '\0';
+		}
+		char *name = trim(s);
+		ok = *name && add_col(t, name);
+		if (!comma) {
+			break;
+		}
+	}
+
+	long cap = 0;
+	while (ok && getline(&line, &n, f) > 0) {
+		char *s = trim(line);
+		if (!*s) { // A blank line
+			continue;
+		}
+		if (t->nrows == cap) {
+			cap = cap ? 2 * cap : 1024;
+			for (int i = 0; i < t->ncols; ++i) {
+				t->cols[i] = realloc((double *)t->cols[i],
+						     cap * sizeof **t->cols);
+			}
+		}
+		for (int i = 0; ok && i < t->ncols; ++i) {
+			char *end;
+			((double *)t->cols[i])[t->nrows] = strtod(s, &end);
+			while (isspace((unsigned char)*end)) {
+				++end;
+			}
+			char sep = i + 1 < t->ncols ? ',' : '\0';
+			ok = end != s && *end == sep;
+			s = end + 1;
+		}
+		++t->nrows;
+	}
+	free(line);
+	return ok && !ferror(f);
+}
+
+// The part of a mapped file yet to be read.
+typedef struct Reader {
+	const char *p, *end;
+} Reader;
+
+// Return the next `n` bytes of `r`, skipping the padding to a word, or `NULL`
+// if the file is too short.
+static const void *take(Reader *r, uint64_t n)
+{
+	uint64_t size = n + -n % WORD;
+	if (size < n || size > (uint64_t)(r->end - r->p)) {
+		return NULL;
+	}
+	const void *p = r->p;
+	r->p += size;
+	return p;
+}
+
+static bool take_table(Reader *r, Table *t)
+{
+	const char *magic = take(r, WORD);
+	const uint64_t *hd = take(r, 2 * WORD);
+	if (!magic || memcmp(magic, MAGIC, WORD) || !hd ||
+	    hd[0] > (uint64_t)(r->end - r->p) / WORD ||
+	    hd[1] > (uint64_t)(r->end - r->p) / WORD) {
+		return false;
+	}
+	for (uint64_t i = 0; i < hd[0]; ++i) {
+		const uint64_t *len = take(r, WORD);
+		const char *name;
+		if (!len || !*len || !(name = take(r, *len))) {
+			return false;
+		}
+		char *s = strndup(name, *len);
+		bool ok = add_col(t, s);
+		free(s);
+		if (!ok) {
+			return false;
+		}
+	}
+	t->nrows = hd[1];
+	for (int i = 0; i < t->ncols; ++i) {
+		// The values are only read, straight from the mapping.
+		if (!(t->cols[i] = take(r, t->nrows * WORD))) {
+			return false;
+		}
+	}
+	return true;
+}
+
+bool load_table(Table *t, const char *path)
+{
+	*t = (Table){0};
+	int fd = open(path, O_RDONLY);
+	if (fd < 0) {
+		return false;
+	}
+	struct stat st;
+	char magic[WORD];
+	bool ok;
+	if (!fstat(fd, &st) && st.st_size >= (off_t)WORD &&
+	    pread(fd, magic, WORD, 0) == WORD && !memcmp(magic, MAGIC, WORD)) {
+		t->map = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+		close(fd);
+		if (t->map == MAP_FAILED) {
+			t->map = NULL;
+			return false;
+		}
+		t->size = st.st_size;
+		Reader r = {t->map, (char *)t->map + st.st_size};
+		ok = take_table(&r, t);
+	} else {
+		FILE *f = fdopen(fd, "r");
+		ok = read_csv(t, f);
+		fclose(f);
+	}
+	if (!ok) {
+		free_table(t);
+	}
+	return ok;
+}
+
+void free_table(Table *t)
+{
+	if (t->map) {
+		munmap(t->map, t->size);
+	} else {
+		for (int i = 0; i < t->ncols; ++i) {
+			free((double *)t->cols[i]);
+		}
+	}
+	free(t->syms);
+	free(t->cols);
+	*t = (Table){0};
+}
+
+// The plan evaluating a polynomial, in arrays indexed by its terms, the powers
+// of columns it has, and the factors of its terms. A term is the product of its
+// coefficient and its factors, each a power of a column. Terms are sorted, so
+// that the ones sharing leading factors are adjacent, and each term extends
+// the product of the leading factors it shares with the previous one.
+typedef struct Plan {
+	int nterms;
+	double *coef; // Coefficient of each term
+	int *keep;    // Number of factors shared with the previous term
+	int *len;     // Number of factors of each term
+	int *start;   // Index of the first factor not shared in `factor`
+	int *factor;  // Power of each factor not shared, an index of `col`
+	int npows;
+	int *col;  // Column of each power
+	long *exp; // Exponent of each power
+	int depth; // Greatest number of factors of a term
+} Plan;
+
+static void free_plan(Plan *pl)
+{
+	free(pl->coef);
+	free(pl->keep);
+	free(pl->len);
+	free(pl->start);
+	free(pl->factor);
+	free(pl->col);
+	free(pl->exp);
+}
+
+// Return the index of the power `exp` of the column `col` in `pl`, adding it if
+// it is new. `head` maps each column to its last power, and `prev` each power
+// to the previous one of the same column, or -1.
+static int add_pow(Plan *pl, int **prev, int *head, int col, long exp)
+{
+	for (int i = head[col]; i >= 0; i = (*prev)[i]) {
+		if (pl->exp[i] == exp) {
+			return i;
+		}
+	}
+	int i = pl->npows++;
+	pl->col = realloc(pl->col, pl->npows * sizeof *pl->col);
+	pl->exp = realloc(pl->exp, pl->npows * sizeof *pl->exp);
+	*prev = realloc(*prev, pl->npows * sizeof **prev);
+	pl->col[i] = col;
+	pl->exp[i] = exp;
+	(*prev)[i] = head[col];
+	head[col] = i;
+	return i;
+}
+
+// Make the plan `pl` evaluating `p` at the rows of `t`. Return -1, or a
+// variable of `p` that `t` has no column of.
+static int make_plan(Plan *pl, const TermNode *p, const Table *t)
+{
+	int n = 0, nfactors = 0;
+	for (const TermNode *q = p; q; q = q->next) {
+		++n;
+		for (const TermNode *v = q->u.vars; v; v = v->next) {
+			++nfactors;
+		}
+	}
+	*pl = (Plan){n,
+		     malloc(n * sizeof *pl->coef),
+		     malloc(n * sizeof *pl->keep),
+		     malloc(n * sizeof *pl->len),
+		     malloc((n + 1) * sizeof *pl->start),
+		     malloc(nfactors * sizeof *pl->factor),
+		     0,
+		     NULL,
+		     NULL,
+		     0};
+
+	// Columns by symbol, and the powers of each column
+	int nsyms = sym_count();
+	int *colof = malloc(nsyms * sizeof *colof);
+	int *head = malloc(t->ncols * sizeof *head), *prev = NULL;
+	for (int i = 0; i < nsyms; ++i) {
+		colof[i] = -1;
+	}
+	for (int i = 0; i < t->ncols; ++i) {
+		colof[t->syms[i]] = i;
+		head[i] = -1;
+	}
+
+	int missing = -1;
+	const TermNode *last = NULL; // Factors of the previous term
+	nfactors = 0;
+	for (int i = 0; i < n && missing < 0; ++i, p = p->next) {
+		Coeff c = coeff_of(p);
+		pl->coef[i] = coeff_double(&c);
+		const TermNode *v = p->u.vars;
+		int keep = 0;
+		for (; v && last && v->hd.sym == last->hd.sym &&
+		       v->u.pow == last->u.pow;
+		     v = v->next, last = last->next) {
+			++keep;
+		}
+		pl->keep[i] = keep;
+		pl->start[i] = nfactors;
+		for (; v; v = v->next) {
+			int col = colof[v->hd.sym];
+			if (col < 0) {
+				missing = v->hd.sym;
+				break;
+			}
+			pl->factor[nfactors++] =
+				add_pow(pl, &prev, head, col, v->u.pow);
+		}
+		pl->len[i] = keep + nfactors - pl->start[i];
+		if (pl->len[i] > pl->depth) {
+			pl->depth = pl->len[i];
+		}
+		last = p->u.vars;
+	}
+	pl->start[n] = nfactors;
+	free(colof);
+	free(head);
+	free(prev);
+	if (missing >= 0) {
+		free_plan(pl);
+	}
+	return missing;
+}
+
+// Set `dest` to `x` to the power `exp` for each of the `n` rows.
+static void pow_block(double *restrict dest, const double *restrict x, long exp,
+		      int n)
+{
+	double b[BLOCK];
+	for (int k = 0; k < n; ++k) {
+		dest[k] = 1;
+		b[k] = x[k];
+	}
+	for (; exp; exp >>= 1) {
+		if (exp & 1) {
+			for (int k = 0; k < n; ++k) {
+				dest[k] *= b[k];
+			}
+		}
+		if (exp > 1) {
+			for (int k = 0; k < n; ++k) {
+				b[k] *= b[k];
+			}
+		}
+	}
+}
+
+// Set `dest` to the product of `x` and `y` for each of the `n` rows.
+static void mul_block(double *restrict dest, const double *restrict x,
+		      const double *restrict y, int n)
+{
+	for (int k = 0; k < n; ++k) {
+		dest[k] = x[k] * y[k];
+	}
+}
+
+// Add `c` times `x` to `dest` for each of the `n` rows.
+static void axpy_block(double *restrict dest, double c,
+		       const double *restrict x, int n)
+{
+	for (int k = 0; k < n; ++k) {
+		dest[k] += c * x[k];
+	}
+}
+
+// Print the value of the plan `pl` at each row of `t`.
+static void run_plan(const Plan *pl, const Table *t)
+{
+	double *pows = malloc(pl->npows * BLOCK * sizeof *pows);
+	// The products of the leading factors of the current term
+	double *prods = malloc(pl->depth * BLOCK * sizeof *prods);
+	double sum[BLOCK];
+	for (long row = 0; row < t->nrows; row += BLOCK) {
+		int n = t->nrows - row < BLOCK ? t->nrows - row : BLOCK;
+		for (int i = 0; i < pl->npows; ++i) {
+			pow_block(pows + i * BLOCK, t->cols[pl->col[i]] + row,
+				  pl->exp[i], n);
+		}
+		for (int k = 0; k < n; ++k) {
+			sum[k] = 0;
+		}
+		for (int i = 0; i < pl->nterms; ++i) {
+			// The factors of the term, indexed by their positions
+			const int *f = pl->factor + pl->start[i] - pl->keep[i];
+			for (int d = pl->keep[i]; d < pl->len[i]; ++d) {
+				const double *pow = pows + f[d] * BLOCK;
+				if (d) {
+					mul_block(prods + d * BLOCK,
+						  prods + (d - 1) * BLOCK, pow,
+						  n);
+				} else {
+					memcpy(prods, pow, n * sizeof *prods);
+				}
+			}
+			if (pl->len[i]) {
+				axpy_block(sum, pl->coef[i],
+					   prods + (pl->len[i] - 1) * BLOCK, n);
+			} else {
+				for (int k = 0; k < n; ++k) {
+					sum[k] += pl->coef[i];
+				}
+			}
+		}
+		for (int k = 0; k < n; ++k) {
+			char s[32];
+			snprintf(s, sizeof s, "%.17g\n", sum[k]);
+			out_str(s);
+		}
+	}
+	free(pows);
+	free(prods);
+}
+
+int eval_table(const TermNode *p, const Table *t)
+{
+	Plan pl;
+	int missing = make_plan(&pl, p, t);
+	if (missing < 0) {
+		run_plan(&pl, t);
+		free_plan(&pl);
+	}
+	return missing;
+}
@@ -0,0 +1,37 @@
+#ifndef EVAL_H
+#define EVAL_H
+
+#include <stdbool.h>
+#include <stddef.h>
+
+// Polynomials can be evaluated numerically at every row of a table of values of
+// their variables. A table is read from a CSV file whose first line names the
+// columns, or from a binary file of native-endian 64-bit words:
+//
+//   header:  "POLYTAB1", number of columns, number of rows
+//   per column: the length of its name and the name, padded to a word
+//   per column: its values as `double`s
+//
+// A binary table is mapped into memory and evaluated in place.
+
+typedef struct Table {
+	int ncols;
+	long nrows;
+	int *syms;	     // Symbol named by each column
+	const double **cols; // Values of each column
+	void *map;	     // Mapping of a binary file, or `NULL`
+	size_t size;	     // Length of `map`
+} Table;
+
+// Load the table in the file `path` to `t`.
+bool load_table(Table *t, const char *path);
+
+// Release the table `t`.
+void free_table(Table *t);
+
+struct TermNode;
+// Print the value of `p` at each row of `t`, one per line. Return -1, or a
+// variable of `p` that `t` has no column of, printing nothing.
+int eval_table(const struct TermNode *p, const Table *t);
+
+#endif /* ifndef EVAL_H */
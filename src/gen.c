@@ -0,0 +1,399 @@
+#define _POSIX_C_SOURCE 200809L // strdup
+#include "gen.h"
+#include "coeff.h"
+#include "out.h"
+#include "sym.h"
+#include "term.h"
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// A term being factored, whose factors before `vars` are factored out.
+typedef struct Item {
+	const TermNode *term, *vars;
+} Item;
+
+// A power of a variable used as a factor, kept in a temporary.
+typedef struct Pow {
+	int sym;
+	long exp;
+	int temp;
+} Pow;
+
+typedef struct Gen {
+	bool print; // Whether to print, or only to record the powers used
+	Pow *pows;
+	int npows, cap;
+	char **names;	   // C names of the variables, indexed by symbols
+	const char *temps; // Name of the array of temporaries
+} Gen;
+
+// Order powers by their variables, in the order of the terms, and then by
+// their exponents.
+static int pow_cmp(const void *p1, const void *p2)
+{
+	const Pow *a = p1, *b = p2;
+	int cmp = sym_cmp(a->sym, b->sym);
+	return cmp ? cmp : (a->exp > b->exp) - (a->exp < b->exp);
+}
+
+// Print, or record, the variable `sym` to the power `exp`.
+static void print_pow(Gen *g, int sym, long exp)
+{
+	if (exp == 1) {
+		if (g->print) {
+			out_str(g->names[sym]);
+		}
+		return;
+	}
+	Pow key = {sym, exp, 0};
+	if (g->print) {
+		const Pow *pow =
+			bsearch(&key, g->pows, g->npows, sizeof key, pow_cmp);
+		out_str(g->temps);
+		out_char('[');
+		out_long(pow->temp);
+		out_char(']');
+		return;
+	}
+	if (g->npows == g->cap) {
+		g->cap = g->cap ? 2 * g->cap : 16;
+		g->pows = realloc(g->pows, g->cap * sizeof *g->pows);
+	}
+	g->pows[g->npows++] = key;
+}
+
+// Print `c` as a C constant.
+static void print_c_coeff(const Coeff *c)
+{
+	char s[32];
+	switch (c->type) {
+	case ICOEFF_TERM:
+		out_long(c->hd.ival);
+		break;
+	case RCOEFF_TERM:
+		snprintf(s, sizeof s, "%.17g", c->hd.rval);
+		out_str(s);
+		break;
+	case BCOEFF_TERM:
+		print_coeff(c);
+		out_str(".0");
+		break;
+	case QCOEFF_TERM:
+		// The numerator is made a `double` for the division.
+		out_char('(');
+		print_c_coeff(&c->hd.rat->num);
+		if (c->hd.rat->num.type == ICOEFF_TERM) {
+			out_str(".0");
+		}
+		out_str(" / ");
+		print_c_coeff(&c->hd.rat->den);
+		out_char(')');
+		break;
+	default:
+		fprintf(stderr, "unexpected node type %d\n", c->type);
+		abort();
+	}
+}
+
+static void print_sum(Gen *g, Item *it, int n);
+
+// Print the sum of the `n` items `it` whose leading variable is `sym`, e.g.,
+// `x^3 y + x^3 + x` as `x * (1 + x^2 * (y + 1))`.
+static void print_horner(Gen *g, Item *it, int n, int sym)
+{
+	int open = 0;
+	long outer = 0; // Power of `sym` factored out so far
+	// Each group of the items of the same power of `sym` is factored from
+	// the last one, of the lowest power.
+	for (int end = n, begin; end; end = begin) {
+		long exp = it[end - 1].vars->u.pow;
+		for (begin = end - 1; begin && it[begin - 1].vars->u.pow == exp;
+		     --begin) {
+		}
+		for (int i = begin; i < end; ++i) {
+			it[i].vars = it[i].vars->next;
+		}
+		print_pow(g, sym, exp - outer);
+		outer = exp;
+
+		const TermNode *t = it[begin].term;
+		if (end - begin == 1 && !it[begin].vars &&
+		    t->type == ICOEFF_TERM && t->hd.ival == 1) {
+			// A cofactor of 1
+			if (begin && g->print) {
+				out_str(" * (1 + ");
+				++open;
+			}
+			continue;
+		}
+		bool paren = begin || end - begin > 1;
+		if (g->print) {
+			out_str(paren ? " * (" : " * ");
+		}
+		open += paren;
+		print_sum(g, it + begin, end - begin);
+		if (begin && g->print) {
+			out_str(" + ");
+		}
+	}
+	for (; g->print && open; --open) {
+		out_char(')');
+	}
+}
+
+// Print the sum of the `n` sorted items `it`.
+static void print_sum(Gen *g, Item *it, int n)
+{
+	for (int m; n; it += m, n -= m) {
+		if (!it->vars) { // The constant term comes last.
+			if (g->print) {
+				Coeff c = coeff_of(it->term);
+				print_c_coeff(&c);
+			}
+			break;
+		}
+		int sym = it->vars->hd.sym;
+		for (m = 1; m < n && it[m].vars && it[m].vars->hd.sym == sym;
+		     ++m) {
+		}
+		print_horner(g, it, m, sym);
+		if (m < n && g->print) {
+			out_str(" + ");
+		}
+	}
+}
+
+// Print, or record the powers used by, the sum of the `n` terms of `p`.
+static void print_terms(Gen *g, const TermNode *p, int n)
+{
+	Item *it = malloc(n * sizeof *it);
+	for (int i = 0; i < n; ++i, p = p->next) {
+		it[i] = (Item){p, p->u.vars};
+	}
+	print_sum(g, it, n);
+	free(it);
+}
+
+// Order symbols in the order of the terms.
+static int sym_ptr_cmp(const void *s1, const void *s2)
+{
+	return sym_cmp(*(const int *)s1, *(const int *)s2);
+}
+
+// Print the computation of the powers recorded in `g` to the temporaries, from
+// the repeated squares of their variables, e.g., `x^6` as `x^4 * x^2`.
+static void print_pows(Gen *g)
+{
+	if (!g->npows) {
+		return;
+	}
+	// The powers used, and the squares needed to compute them
+	qsort(g->pows, g->npows, sizeof *g->pows, pow_cmp);
+	int len = 0, ntemps = 0;
+	for (int i = 0; i < g->npows; ++i) {
+		if (!len || pow_cmp(&g->pows[len - 1], &g->pows[i])) {
+			g->pows[len++] = g->pows[i];
+		}
+	}
+	for (int i = 0; i < len; ++i) {
+		long exp = g->pows[i].exp;
+		if (i + 1 == len || g->pows[i + 1].sym != g->pows[i].sym) {
+			for (long e = exp; e > 1; e >>= 1) {
+				++ntemps;
+			}
+		}
+		ntemps += (exp & (exp - 1)) != 0;
+	}
+	g->npows = len;
+	if (!ntemps) {
+		return;
+	}
+	out_str("\tdouble ");
+	out_str(g->temps);
+	out_char('[');
+	out_long(ntemps);
+	out_str("];\n");
+
+	int temp = 0;
+	for (int i = 0, j; i < g->npows; i = j) {
+		int sym = g->pows[i].sym;
+		for (j = i; j < g->npows && g->pows[j].sym == sym; ++j) {
+		}
+		// `sq[k]` is the temporary of `sym` to the power 2^k.
+		int sq[64];
+		for (int k = 1; 1L << k <= g->pows[j - 1].exp; ++k) {
+			sq[k] = temp++;
+			out_char('\t');
+			out_str(g->temps);
+			out_char('[');
+			out_long(sq[k]);
+			out_str("] = ");
+			for (int f = 0; f < 2; ++f) {
+				if (k == 1) {
+					out_str(g->names[sym]);
+				} else {
+					out_str(g->temps);
+					out_char('[');
+					out_long(sq[k - 1]);
+					out_char(']');
+				}
+				out_str(f ? ";\n" : " * ");
+			}
+		}
+		for (; i < j; ++i) {
+			long exp = g->pows[i].exp;
+			int k = 0;
+			while (exp >> (k + 1)) {
+				++k;
+			}
+			if (!(exp & (exp - 1))) {
+				g->pows[i].temp = sq[k];
+				continue;
+			}
+			g->pows[i].temp = temp++;
+			out_char('\t');
+			out_str(g->temps);
+			out_char('[');
+			out_long(g->pows[i].temp);
+			out_str("] = ");
+			for (bool first = true; k >= 0; --k) {
+				if (!(exp >> k & 1)) {
+					continue;
+				}
+				if (!first) {
+					out_str(" * ");
+				}
+				first = false;
+				if (k) {
+					out_str(g->temps);
+					out_char('[');
+					out_long(sq[k]);
+					out_char(']');
+				} else {
+					out_str(g->names[sym]);
+				}
+			}
+			out_str(";\n");
+		}
+	}
+}
+
+// Keywords of C, up to C23, which variables must not be named after.
+static const char *const keywords[] = {
+	"alignas", "alignof", "auto", "bool", "break", "case", "char", "const",
+	"constexpr", "continue", "default", "do", "double", "else", "enum",
+	"extern", "false", "float", "for", "goto", "if", "inline", "int",
+	"long", "nullptr", "register", "restrict", "return", "short", "signed",
+	"sizeof", "static", "static_assert", "struct", "switch",
+	"thread_local", "true", "typedef", "typeof", "typeof_unqual", "union",
+	"unsigned", "void", "volatile", "while",
+};
+
+// Whether `name` is a keyword, or an identifier reserved by C, i.e., starting
+// with two underscores or an underscore and an uppercase letter.
+static bool reserved(const char *name)
+{
+	if (name[0] == '_' &&
+	    (name[1] == '_' || (name[1] >= 'A' && name[1] <= 'Z'))) {
+		return true;
+	}
+	for (size_t i = 0; i < sizeof keywords / sizeof *keywords; ++i) {
+		if (!strcmp(name, keywords[i])) {
+			return true;
+		}
+	}
+	return false;
+}
+
+// Whether `name` is one of the first `n` names of `vars` in `names`.
+static bool taken(char **names, const int *vars, int n, const char *name)
+{
+	for (int i = 0; i < n; ++i) {
+		if (names[vars[i]] && !strcmp(names[vars[i]], name)) {
+			return true;
+		}
+	}
+	return false;
+}
+
+// Name the `nvars` variables `vars` in `names`. A variable is named after its
+// symbol, unless it is reserved, in which case it is prefixed with `v` and
+// suffixed with underscores until it is named apart from the others.
+static void name_vars(char **names, const int *vars, int nvars)
+{
+	for (int i = 0; i < nvars; ++i) {
+		const char *name = sym_name(vars[i]);
+		if (!reserved(name)) {
+			names[vars[i]] = strdup(name);
+		}
+	}
+	for (int i = 0; i < nvars; ++i) {
+		const char *name = sym_name(vars[i]);
+		if (names[vars[i]]) {
+			continue;
+		}
+		size_t len = strlen(name) + 1;
+		char *s = malloc(len + 1);
+		s[0] = 'v';
+		strcpy(s + 1, name);
+		while (taken(names, vars, nvars, s)) {
+			s = realloc(s, ++len + 1);
+			strcat(s, "_");
+		}
+		names[vars[i]] = s;
+	}
+}
+
+void print_c(const TermNode *p, const char *name)
+{
+	// The variables of `p`, in the order of the terms
+	int nsyms = sym_count(), nvars = 0, n = 0;
+	bool *seen = calloc(nsyms, sizeof *seen);
+	int *vars = malloc(nsyms * sizeof *vars);
+	for (const TermNode *t = p; t; t = t->next, ++n) {
+		for (const TermNode *v = t->u.vars; v; v = v->next) {
+			if (!seen[v->hd.sym]) {
+				seen[v->hd.sym] = true;
+				vars[nvars++] = v->hd.sym;
+			}
+		}
+	}
+	qsort(vars, nvars, sizeof *vars, sym_ptr_cmp);
+	char **names = calloc(nsyms, sizeof *names);
+	name_vars(names, vars, nvars);
+
+	out_str("double ");
+	out_str(name);
+	out_char('(');
+	for (int i = 0; i < nvars; ++i) {
+		out_str(i ? ", double " : "double ");
+		out_str(names[vars[i]]);
+	}
+	out_str(nvars ? ")\n{\n" : "void)\n{\n");
+
+	// The temporaries are named apart from the variables.
+	char *temps = malloc(strlen("t") + nvars + 1);
+	strcpy(temps, "t");
+	while (taken(names, vars, nvars, temps)) {
+		strcat(temps, "_");
+	}
+
+	Gen g = {false, NULL, 0, 0, names, temps};
+	print_terms(&g, p, n);
+	print_pows(&g);
+	g.print = true;
+	out_str("\treturn ");
+	print_terms(&g, p, n);
+	out_str(";\n}\n");
+
+	for (int i = 0; i < nvars; ++i) {
+		free(names[vars[i]]);
+	}
+	free(names);
+	free(g.pows);
+	free(temps);
+	free(vars);
+	free(seen);
+}
@@ -0,0 +1,17 @@
+#ifndef GEN_H
+#define GEN_H
+
+// Polynomials can be printed as C functions evaluating them in `double`s with
+// few multiplications. The terms are factored in multivariate Horner form,
+// following the order of the terms: the leading variable of the terms is
+// factored out of them, power by power, and their cofactors are factored in
+// turn. Powers of a variable used as factors are computed once, ahead, from its
+// repeated squares.
+
+struct TermNode;
+// Print a C function named `name` evaluating `p`, whose parameters are the
+// variables of `p` in the order of the terms. Variables named like C keywords
+// or reserved identifiers are renamed.
+void print_c(const struct TermNode *p, const char *name);
+
+#endif /* ifndef GEN_H */
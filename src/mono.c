@@ -0,0 +1,130 @@
+#include "mono.h"
+#include "sym.h"
+#include "term.h"
+#include <stdlib.h>
+#include <string.h>
+
+static int sym_qcmp(const void *a, const void *b)
+{
+	return sym_cmp(*(const int *)a, *(const int *)b);
+}
+
+// Append the variables occuring in `p` to `syms`, which holds `*len` entries
+// out of `*cap`.
+static int *collect_syms(const TermNode *p, int *syms, int *len, int *cap)
+{
+	for (; p; p = p->next) {
+		for (const TermNode *v = p->u.vars; v; v = v->next) {
+			if (*len == *cap) {
+				*cap = *cap ? *cap * 2 : 16;
+				syms = realloc(syms, *cap * sizeof *syms);
+			}
+			syms[(*len)++] = v->hd.sym;
+		}
+	}
+	return syms;
+}
+
+// Return the highest exponent of a single variable occuring in `p`.
+long max_pow(const TermNode *p)
+{
+	long max = 0;
+	for (; p; p = p->next) {
+		for (const TermNode *v = p->u.vars; v; v = v->next) {
+			if (v->u.pow > max) {
+				max = v->u.pow;
+			}
+		}
+	}
+	return max;
+}
+
+// Allocate a layout over the variables occuring in `p1` and `p2`, whose fields
+// are wide enough to hold exponents up to `maxexp`. `p2` may be `NULL`.
+MonoLayout *new_layout(const TermNode *p1, const TermNode *p2, long maxexp)
+{
+	int len = 0, cap = 0;
+	int *syms = collect_syms(p1, NULL, &len, &cap);
+	syms = collect_syms(p2, syms, &len, &cap);
+	if (len) {
+		qsort(syms, len, sizeof *syms, sym_qcmp);
+	}
+	int nvars = 0;
+	for (int i = 0; i < len; ++i) {
+		if (!nvars || syms[nvars - 1] != syms[i]) {
+			syms[nvars++] = syms[i];
+		}
+	}
+
+	int bits = 1;
+	while (bits < 63 && (maxexp >> bits)) {
+		++bits;
+	}
+	int per_word = 64 / bits;
+
+	MonoLayout *lay = malloc(sizeof *lay);
+	*lay = (MonoLayout){nvars, syms, bits,
+			    (nvars + per_word - 1) / per_word};
+	return lay;
+}
+
+// Pack a `VAR_TERM` list `vars` into `m` using `lay`.
+// Both `vars` and `lay->syms` are sorted, so they are walked in lockstep.
+void mono_pack(const MonoLayout *lay, const TermNode *vars, uint64_t *m)
+{
+	memset(m, 0, lay->nwords * sizeof *m);
+	int per_word = 64 / lay->bits;
+	for (int i = 0; vars; vars = vars->next) {
+		while (lay->syms[i] != vars->hd.sym) {
+			++i;
+		}
+		int shift = 64 - lay->bits * (i % per_word + 1);
+		m[i / per_word] |= (uint64_t)vars->u.pow << shift;
+	}
+}
+
+// Return a `VAR_TERM` list unpacked from `m`.
+TermNode *mono_unpack(const MonoLayout *lay, const uint64_t *m)
+{
+	int per_word = 64 / lay->bits;
+	uint64_t mask = ((uint64_t)1 << lay->bits) - 1;
+	TermNode *hd = NULL, **p = &hd;
+	for (int i = 0; i < lay->nvars; ++i) {
+		int shift = 64 - lay->bits * (i % per_word + 1);
+		long pow = (m[i / per_word] >> shift) & mask;
+		if (pow) {
+			*p = var_term(lay->syms[i], pow);
+			p = &(*p)->next;
+		}
+	}
+	return hd;
+}
+
+// Return the index of the only variable of `m`, -1 if `m` has no variables, or
+// -2 if it has more than one.
+int mono_var(const MonoLayout *lay, const uint64_t *m)
+{
+	int per_word = 64 / lay->bits;
+	uint64_t mask = ((uint64_t)1 << lay->bits) - 1;
+	int var = -1;
+	for (int i = 0; i < lay->nvars; ++i) {
+		int shift = 64 - lay->bits * (i % per_word + 1);
+		if ((m[i / per_word] >> shift) & mask) {
+			if (var >= 0) {
+				return -2;
+			}
+			var = i;
+		}
+	}
+	return var;
+}
+
+// Release `lay`.
+void free_layout(MonoLayout *lay)
+{
+	if (!lay) {
+		return;
+	}
+	free(lay->syms);
+	free(lay);
+}
@@ -0,0 +1,80 @@
+#ifndef MONO_H
+#define MONO_H
+
+#include <stdint.h>
+
+// A packed monomial is an array of `nwords` 64-bit words holding the exponent
+// of every variable of a layout in a fixed-width field. Variables are laid out
+// in the order `var_cmp` prioritizes them, starting from the most significant
+// bits of the first word, so that comparing two monomials is a word-wise
+// unsigned comparison and multiplying them is a word-wise addition.
+//
+// Layout of x^3 y z^2 over {x, y, z} with 4-bit fields:
+//
+//  word 0 (MSB first)
+// +------+------+------+---- ... ----+
+// | 0011 | 0001 | 0010 | 0000 ...    |
+// +------+------+------+---- ... ----+
+//    x      y      z
+typedef struct MonoLayout {
+	int nvars;
+	int *syms;  // Variables sorted by `sym_cmp`.
+	int bits;   // Width of an exponent field.
+	int nwords; // Number of words of a packed monomial.
+} MonoLayout;
+
+struct TermNode;
+// Return the highest exponent of a single variable occuring in `p`.
+long max_pow(const struct TermNode *p);
+
+// Allocate a layout over the variables occuring in `p1` and `p2`, whose fields
+// are wide enough to hold exponents up to `maxexp`. `p2` may be `NULL`.
+MonoLayout *new_layout(const struct TermNode *p1, const struct TermNode *p2,
+		       long maxexp);
+
+// Pack a `VAR_TERM` list `vars` into `m` using `lay`.
+void mono_pack(const MonoLayout *lay, const struct TermNode *vars,
+	       uint64_t *m);
+
+// Return a `VAR_TERM` list unpacked from `m`.
+struct TermNode *mono_unpack(const MonoLayout *lay, const uint64_t *m);
+
+// Return the index of the only variable of `m`, -1 if `m` has no variables, or
+// -2 if it has more than one.
+int mono_var(const MonoLayout *lay, const uint64_t *m);
+
+// Compare two packed monomials in the order of `var_cmp`.
+static inline int mono_cmp(const uint64_t *m1, const uint64_t *m2, int nwords)
+{
+	for (int i = 0; i < nwords; ++i) {
+		if (m1[i] != m2[i]) {
+			return m1[i] > m2[i] ? 1 : -1;
+		}
+	}
+	return 0;
+}
+
+// Store the product of `m1` and `m2` to `dest`.
+// The fields must be wide enough to hold the resulting exponents.
+static inline void mono_mul(uint64_t *dest, const uint64_t *m1,
+			    const uint64_t *m2, int nwords)
+{
+	for (int i = 0; i < nwords; ++i) {
+		dest[i] = m1[i] + m2[i];
+	}
+}
+
+// Store `m` raised to the power of `k` to `dest`.
+// The fields must be wide enough to hold the resulting exponents.
+static inline void mono_scale(uint64_t *dest, const uint64_t *m, long k,
+			      int nwords)
+{
+	for (int i = 0; i < nwords; ++i) {
+		dest[i] = m[i] * k;
+	}
+}
+
+// Release `lay`.
+void free_layout(MonoLayout *lay);
+
+#endif /* ifndef MONO_H */
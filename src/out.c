@@ -0,0 +1,93 @@
+#include "out.h"
+#include "util.h"
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+
+#define OUT_SIZE (64 * 1024)
+
+static _Thread_local struct {
+	char data[OUT_SIZE];
+	size_t len;
+} buf;
+
+// Write out the buffered output.
+void out_flush(void)
+{
+	fwrite(buf.data, 1, buf.len, stmt_out);
+	buf.len = 0;
+}
+
+// Print the `n` characters at `s`.
+static void out_mem(const char *s, size_t n)
+{
+	while (n) {
+		if (buf.len == OUT_SIZE) {
+			out_flush();
+		}
+		size_t m = OUT_SIZE - buf.len < n ? OUT_SIZE - buf.len : n;
+		memcpy(&buf.data[buf.len], s, m);
+		buf.len += m;
+		s += m;
+		n -= m;
+	}
+}
+
+// Print the character `c`.
+void out_char(char c)
+{
+	if (buf.len == OUT_SIZE) {
+		out_flush();
+	}
+	buf.data[buf.len++] = c;
+}
+
+// Print the string `s`.
+void out_str(const char *s) { out_mem(s, strlen(s)); }
+
+// Print `v`, with at least `width` digits.
+static void out_ulong(unsigned long v, int width)
+{
+	char s[20];
+	int i = sizeof s;
+	do {
+		s[--i] = '0' + v % 10;
+		v /= 10;
+	} while (v || (int)sizeof s - i < width);
+	out_mem(&s[i], sizeof s - i);
+}
+
+// Print `v` in decimal.
+void out_long(long v)
+{
+	if (v < 0) {
+		out_char('-');
+		out_ulong(-(unsigned long)v, 1);
+	} else {
+		out_ulong(v, 1);
+	}
+}
+
+// Print `v` with six decimal places, as `printf`'s `%f` does.
+// `%f` rounds the exact value of `v * 1e6` to an integer. Its rounded product
+// is within 2^-13 of the exact one as long as it is less than 2^40, so the two
+// round alike unless the product is about halfway between two integers. Such
+// values, as well as large or non-finite ones, are left to `snprintf`.
+void out_double(double v)
+{
+	double x = v * 1e6;
+	double r = nearbyint(x);
+	if (fabs(x) < 0x1p40 && fabs(x - r) < 0.5 - 0x1p-10) {
+		unsigned long n = fabs(r);
+		if (signbit(v)) {
+			out_char('-');
+		}
+		out_ulong(n / 1000000, 1);
+		out_char('.');
+		out_ulong(n % 1000000, 6);
+		return;
+	}
+	char s[512]; // Enough for `DBL_MAX`.
+	int n = snprintf(s, sizeof s, "%f", v);
+	out_mem(s, n);
+}
@@ -0,0 +1,24 @@
+#ifndef OUT_H
+#define OUT_H
+
+// The output of statements is formatted by hand into a per-thread buffer, which
+// is written to `stmt_out` in large blocks: whenever it fills up, and when
+// flushed. Long results are thus streamed out a block at a time, without being
+// built up as a whole.
+
+// Print the character `c`.
+void out_char(char c);
+
+// Print the string `s`.
+void out_str(const char *s);
+
+// Print `v` in decimal.
+void out_long(long v);
+
+// Print `v` with six decimal places, as `printf`'s `%f` does.
+void out_double(double v);
+
+// Write out the buffered output.
+void out_flush(void);
+
+#endif /* ifndef OUT_H */
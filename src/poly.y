@@ -1,5 +1,19 @@
 %code top {
+// The parser stack is on the heap, and may grow far beyond Bison's default
+// limit for deeply nested input.
+#define YYMAXDEPTH 10000000
+#include "batch.h"
+#include "cache.h"
+#include "eval.h"
+#include "gen.h"
+#include "out.h"
+#include "pool.h"
+#include "stats.h"
+#include "store.h"
+#include "sym.h"
 #include "term.h"
+#include "util.h"
+#include "vec.h"
 #include <stdbool.h>
 #include <stdio.h>
 #include <stdlib.h>
@@ -11,102 +25,48 @@
 #include "rel.h"
 }
 
+%code {
+static void stmt(ASTNode *node, Env *env, bool verbose);
+static void end_stmt(void);
+}
+
 %start	prgm
 
 %union {
 	long	inum;
+	struct BigInt *big;
 	double	rnum;
-	char	*var;
+	int	sym;
 	Rel	rel;
 	ASTNode	*node;
 }
 
 %token	<rnum>	RNUM
 %token	<inum>	INUM
-%token	<var>	VAR
+%token	<big>	BNUM
+%token	<sym>	VAR
 %token	<rel>	REL
 %token		ASGN
 
 %type	<node>	atom expt neg mult poly rels asgn
 
-%destructor { free($$); }	VAR
-%destructor { free_node($$); }	<node>
+%destructor { free($$); } <big>
 
-%parse-param { EnvFrame **env } { bool *verbose }
+%parse-param { Env *env } { bool *verbose }
 
 %%
 
 prgm:	  // nothing
 	| prgm '\n'
-	| prgm error '\n'
-	| prgm rels '\n' {
-		if (*verbose) {
-			printf("AST: ");
-			print_node($2);
-			putchar('\n');
-		}
-		RelNode *r;
-		if ((r = eval_rel($2, *env))) {
-			if (*verbose) {
-				printf("REL: ");
-			}
-			print_rel(r);
-			putchar('\n');
-			free_rel(r);
-		}
-		if (*verbose) {
-			putchar('\n');
-		}
-		free_node($2); }
-	| prgm poly '\n' {
-		if (*verbose) {
-			printf("AST: ");
-			print_node($2);
-			putchar('\n');
-		}
-		TermNode *p;
-		if ((p = eval_poly($2, *env))) {
-			if (*verbose) {
-				printf("VAL: ");
-			}
-			print_poly(p);
-			putchar('\n');
-			free_poly(p);
-		}
-		if (*verbose) {
-			putchar('\n');
-		}
-		free_node($2); }
-	| prgm asgn '\n' {
-		if (*verbose) {
-			printf("AST: ");
-			print_node($2);
-			putchar('\n');
-		}
-		const char *name = $2->u.asgndat.left->u.name;
-		TermNode *p;
-		if ((p = eval_asgn($2, env))) {
-			if (*verbose) {
-				printf("ASN: %s := ", name);
-			}
-			print_poly(p);
-			putchar('\n');
-		} else {
-			fprintf(stderr, "Variable %s is already defined or "
-			       "self-referenced.\n",
-			       name);
-		}
-		if (*verbose) {
-			putchar('\n');
-		}
-		free_node($2); }
+	| prgm error '\n' { end_stmt(); }
+	| prgm rels '\n' { stmt($2, env, *verbose); }
+	| prgm poly '\n' { stmt($2, env, *verbose); }
+	| prgm asgn '\n' { stmt($2, env, *verbose); }
 	;
 asgn:	  VAR ASGN poly	{ $$ = asgn_node(var_node($1), $3); }
 	;
-rels:	  poly REL poly	{ $$ = rel_node($2, $1, $3); }
-	| poly REL poly '&' rels {
-		$$ = rel_node($2, $1, $3);
-		$$->u.reldat.next = $5; }
+rels:	  poly REL poly	{ $$ = rel_node($2, $1, $3, NULL); }
+	| poly REL poly '&' rels { $$ = rel_node($2, $1, $3, $5); }
 	;
 poly:	  mult
 	| poly '+' mult	{ $$ = op_node(ADD, $1, $3); }
@@ -124,6 +84,7 @@ expt:	  atom
 	| atom '^' neg	{ $$ = op_node(POW, $1, $3); }
 	;
 atom:	  INUM	{ $$ = inum_node($1); }
+	| BNUM	{ $$ = bnum_node($1); }
 	| RNUM	{ $$ = rnum_node($1); }
 	| VAR	{ $$ = var_node($1); }
 	| '(' poly ')'	{ $$ = $2; }
@@ -134,6 +95,170 @@ char *progname;
 int lineno = 1;
 extern FILE *yyin;
 
+// Allocators of the statement being evaluated.
+static Arena ast_arena;
+static Pool tmp_terms;
+
+// Whether statements are recorded to be evaluated at once by `batch_run`.
+static bool batch;
+
+// Values of the variables at which polynomials are evaluated, if `tabulate`.
+static Table table;
+static bool tabulate;
+
+// Whether polynomials are printed as C functions.
+static bool gen_c;
+
+// Return the number of terms of `p`.
+static long nterms(const TermNode *p)
+{
+	long n = 0;
+	for (; p; p = p->next) {
+		++n;
+	}
+	return n;
+}
+
+// Return the number of terms of the relations `r`.
+static long rel_terms(const RelNode *r)
+{
+	long n = 0;
+	for (; r; r = r->next) {
+		n += nterms(r->left) + nterms(r->right);
+	}
+	return n;
+}
+
+// Evaluate and print the statement `node`.
+static void run_stmt(const ASTNode *node, Env *env, bool verbose)
+{
+	long out_terms = 0;
+	begin_eval();
+	if (verbose) {
+		out_str("AST: ");
+		print_node(node);
+		out_char('\n');
+	}
+	switch (node->type) {
+	case REL_NODE: {
+		RelNode *r;
+		if ((r = eval_rel(node, env))) {
+			if (verbose) {
+				out_str("REL: ");
+			}
+			print_rel(r);
+			out_char('\n');
+			if (stats) {
+				out_terms = rel_terms(r);
+			}
+			free_rel(r);
+		}
+		break;
+	}
+	case ASGN_NODE: {
+		const char *name = sym_name(node->u.asgndat.left->u.sym);
+		TermNode *p;
+		if ((p = eval_asgn(node, env))) {
+			if (verbose) {
+				out_str("ASN: ");
+				out_str(name);
+				out_str(" := ");
+			}
+			print_poly(p);
+			out_char('\n');
+			if (stats) {
+				out_terms = nterms(p);
+			}
+		} else {
+			out_flush();
+			fprintf(stmt_err, "Variable %s is already defined or "
+					  "self-referenced.\n",
+				name);
+		}
+		break;
+	}
+	default: {
+		if (streamed(node)) {
+			PolyStream *ps;
+			if ((ps = eval_stream(node, env))) {
+				if (verbose) {
+					out_str("VAL: ");
+				}
+				long n = print_stream(ps);
+				out_char('\n');
+				if (stats) {
+					out_terms = n;
+				}
+			}
+			break;
+		}
+		TermNode *p;
+		if ((p = eval_poly(node, env))) {
+			if (verbose) {
+				out_str("VAL: ");
+			}
+			if (verbose || !(tabulate || gen_c)) {
+				print_poly(p);
+				out_char('\n');
+			}
+			if (gen_c) {
+				// Functions are named apart by their lines.
+				char name[32];
+				snprintf(name, sizeof name, "poly%d",
+					 stmt_stats.line);
+				print_c(p, name);
+			}
+			int sym;
+			if (tabulate && (sym = eval_table(p, &table)) >= 0) {
+				out_flush();
+				fprintf(stmt_err,
+					"Variable %s is not in the table.\n",
+					sym_name(sym));
+			}
+			if (stats) {
+				out_terms = nterms(p);
+			}
+			free_poly(p);
+		}
+		break;
+	}
+	}
+	if (verbose) {
+		out_char('\n');
+	}
+	end_eval(out_terms);
+	out_flush();
+}
+
+// Evaluate the statement `node` just parsed, or record it in batch mode.
+static void stmt(ASTNode *node, Env *env, bool verbose)
+{
+	end_parse(lineno - 1); // The newline ending `node` has been read.
+	compile_stmt(node);
+	if (batch) {
+		batch_add(node);
+	} else {
+		run_stmt(node, env, verbose);
+		free_stmt_code(node);
+	}
+	end_stmt();
+}
+
+// Release everything allocated while evaluating a statement at once.
+// Nothing but the environment and the cache outlives a statement, except in
+// batch mode, where the statements are kept until they are all evaluated.
+static void end_stmt(void)
+{
+	begin_parse();
+	if (batch) {
+		return;
+	}
+	arena_reset(&ast_arena);
+	pool_reset(&tmp_terms);
+	free_evicted();
+	collect_nodes();
+}
+
 int main(int argc, char *argv[])
 {
 	progname = argv[0];
@@ -141,6 +266,8 @@ int main(int argc, char *argv[])
 	// Parse command line arguments.
 	bool verbose = true;
 	bool fin = false;
+	int cache_size = 0, workers = 0;
+	const char *load = NULL, *save = NULL, *tab = NULL;
 	int optidx;
 	for (optidx = 1; optidx < argc && argv[optidx][0] == '-'; ++optidx) {
 		switch (argv[optidx][1]) {
@@ -149,31 +276,136 @@ int main(int argc, char *argv[])
 			break;
 		case 'v':
 			break;
+		case 'b':
+			batch = true;
+			break;
+		case 's':
+			stats = true;
+			break;
+		case 'g':
+			gen_c = true;
+			break;
+		case 't':
+			stream_terms = true;
+			break;
+		case 'c':
+			if (++optidx < argc &&
+			    (cache_size = atoi(argv[optidx])) > 0) {
+				break;
+			}
+			goto usage;
+		case 'j':
+			if (++optidx < argc &&
+			    (vec_threads = atoi(argv[optidx])) > 0) {
+				break;
+			}
+			goto usage;
+		case 'n':
+			if (++optidx < argc &&
+			    (workers = atoi(argv[optidx])) > 0) {
+				break;
+			}
+			goto usage;
+		case 'l':
+			if (++optidx < argc) {
+				load = argv[optidx];
+				break;
+			}
+			goto usage;
+		case 'w':
+			if (++optidx < argc) {
+				save = argv[optidx];
+				break;
+			}
+			goto usage;
+		case 'e':
+			if (++optidx < argc) {
+				tab = argv[optidx];
+				break;
+			}
+			goto usage;
 		default:
-			fprintf(stderr, "Usage: %s [-qv] [file] \n", progname);
+		usage:
+			fprintf(stderr,
+				"Usage: %s [-qvbsgt] [-c size] [-j threads] "
+				"[-n workers] [-l env] [-w env] [-e table] "
+				"[file]\n",
+				progname);
 			exit(EXIT_FAILURE);
 		}
 	}
+	// Statements evaluated concurrently cannot share the cache.
+	if (batch && cache_size) {
+		fprintf(stderr, "%s: -c cannot be used with -b\n", progname);
+		exit(EXIT_FAILURE);
+	}
+	if (!batch && workers) {
+		fprintf(stderr, "%s: -n can only be used with -b\n", progname);
+		exit(EXIT_FAILURE);
+	}
 	argv += optidx; // `argv` points to the remaining non-option arguments.
 	if (*argv) {
 		fin = true;
 		yyin = fopen(*argv, "r");
 	}
 
-	EnvFrame *env = NULL;
-	yyparse(&env, &verbose);
-	free_env(env);
+	stmt_arena = &ast_arena;
+	pool_init(&tmp_terms, sizeof(TermNode));
+	term_pool = &tmp_terms;
+
+	stmt_out = stdout;
+	stmt_err = stderr;
+
+	Env env = {0};
+	if (load && !load_env(&env, load)) {
+		fprintf(stderr, "%s: cannot load %s\n", progname, load);
+		exit(EXIT_FAILURE);
+	}
+	if (tab && !(tabulate = load_table(&table, tab))) {
+		fprintf(stderr, "%s: cannot load %s\n", progname, tab);
+		exit(EXIT_FAILURE);
+	}
+	// Tables and C functions are made of whole polynomials.
+	if (tabulate || gen_c) {
+		stream_terms = false;
+	}
+	begin_parse();
+	if (batch) {
+		// The memos are shared by all statements.
+		memoize = false;
+		batch_begin();
+		yyparse(&env, &verbose);
+		batch_run(&env, verbose, workers, run_stmt);
+	} else {
+		init_cache(cache_size);
+		yyparse(&env, &verbose);
+		out_flush();
+	}
+	print_cache_stats();
+	print_stats();
+	free_cache();
+	bool saved = !save || save_env(&env, save);
+	if (!saved) {
+		fprintf(stderr, "%s: cannot save %s\n", progname, save);
+	}
+	free_env(&env);
+	free_table(&table);
+	free_nodes();
+	free_pool(&tmp_terms);
+	free_arena(&ast_arena);
+	free_syms();
 
 	if (fin) {
 		fclose(yyin);
 	}
-	return 0;
+	return saved ? EXIT_SUCCESS : EXIT_FAILURE;
 }
 
-int yyerror(EnvFrame **env, bool *verbose, const char *msg)
+int yyerror(Env *env, bool *verbose, const char *msg)
 {
 	(void)env;
 	(void)verbose;
-	fprintf(stderr, "%s: %s near line %d\n", progname, msg, lineno);
+	out_flush();
+	fprintf(stmt_err, "%s: %s near line %d\n", progname, msg, lineno);
 	return 0;
 }
@@ -0,0 +1,98 @@
+#include "pool.h"
+#include <stdalign.h>
+#include <stdlib.h>
+
+#define CHUNK_SIZE (64 * 1024)
+
+typedef struct Chunk {
+	struct Chunk *next;
+	size_t size;
+	max_align_t data[];
+} Chunk;
+
+_Thread_local Arena *stmt_arena;
+_Thread_local Pool *term_pool;
+
+// Return `size` bytes from `a`, aligned for any object.
+void *arena_alloc(Arena *a, size_t size)
+{
+	size_t align = alignof(max_align_t);
+	size = (size + align - 1) / align * align;
+	if (!a->chunks || a->used + size > a->chunks->size) {
+		// Requests larger than a chunk get a chunk of their own.
+		size_t csize = size > CHUNK_SIZE ? size : CHUNK_SIZE;
+		Chunk *c = malloc(sizeof *c + csize);
+		*c = (Chunk){a->chunks, csize};
+		a->chunks = c;
+		a->used = 0;
+	}
+	void *p = (char *)a->chunks->data + a->used;
+	a->used += size;
+	return p;
+}
+
+// Release everything allocated from `a`, keeping a chunk for reuse.
+// The oldest chunk is kept, which is never larger than a regular one.
+void arena_reset(Arena *a)
+{
+	Chunk *c = a->chunks;
+	if (!c) {
+		return;
+	}
+	while (c->next) {
+		Chunk *next = c->next;
+		free(c);
+		c = next;
+	}
+	a->chunks = c;
+	a->used = 0;
+}
+
+// Release the memory held by `a`.
+void free_arena(Arena *a)
+{
+	arena_reset(a);
+	free(a->chunks);
+	*a = (Arena){NULL, 0};
+}
+
+// Initialize `p` as an empty pool of objects of `size` bytes.
+void pool_init(Pool *p, size_t size)
+{
+	if (size < sizeof(void *)) {
+		size = sizeof(void *);
+	}
+	*p = (Pool){{NULL, 0}, size, NULL};
+}
+
+// Return an object from `p`.
+void *pool_alloc(Pool *p)
+{
+	if (p->free) {
+		void *obj = p->free;
+		p->free = *(void **)obj;
+		return obj;
+	}
+	return arena_alloc(&p->arena, p->size);
+}
+
+// Return `obj` to `p`.
+void pool_free(Pool *p, void *obj)
+{
+	*(void **)obj = p->free;
+	p->free = obj;
+}
+
+// Release every object of `p`, keeping a chunk for reuse.
+void pool_reset(Pool *p)
+{
+	arena_reset(&p->arena);
+	p->free = NULL;
+}
+
+// Release the memory held by `p`.
+void free_pool(Pool *p)
+{
+	free_arena(&p->arena);
+	p->free = NULL;
+}
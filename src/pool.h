@@ -0,0 +1,53 @@
+#ifndef POOL_H
+#define POOL_H
+
+#include <stddef.h>
+
+// Allocators for nodes sharing a lifetime. An `Arena` hands out memory by
+// bumping a pointer through large chunks, and releases it all at once. A `Pool`
+// hands out objects of a single size from an arena, and recycles released
+// objects through a free list.
+
+struct Chunk;
+typedef struct Arena {
+	struct Chunk *chunks; // The chunk being filled, linked to older ones.
+	size_t used;	      // Bytes used in the chunk being filled.
+} Arena;
+
+typedef struct Pool {
+	Arena arena;
+	size_t size;
+	void *free; // Released objects, each linked to the next one.
+} Pool;
+
+// The arena holding the AST and the relations of the statement being evaluated.
+extern _Thread_local Arena *stmt_arena;
+
+// The pool `TermNode`s are allocated from and released to.
+extern _Thread_local Pool *term_pool;
+
+// Return `size` bytes from `a`, aligned for any object.
+void *arena_alloc(Arena *a, size_t size);
+
+// Release everything allocated from `a`, keeping a chunk for reuse.
+void arena_reset(Arena *a);
+
+// Release the memory held by `a`.
+void free_arena(Arena *a);
+
+// Initialize `p` as an empty pool of objects of `size` bytes.
+void pool_init(Pool *p, size_t size);
+
+// Return an object from `p`.
+void *pool_alloc(Pool *p);
+
+// Return `obj` to `p`.
+void pool_free(Pool *p, void *obj);
+
+// Release every object of `p`, keeping a chunk for reuse.
+void pool_reset(Pool *p);
+
+// Release the memory held by `p`.
+void free_pool(Pool *p);
+
+#endif /* ifndef POOL_H */
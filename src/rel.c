@@ -1,6 +1,8 @@
 #include "rel.h"
+#include "coeff.h"
+#include "out.h"
+#include "pool.h"
 #include "term.h"
-#include "util.h"
 #include <stdbool.h>
 #include <stdio.h>
 #include <stdlib.h>
@@ -26,7 +28,7 @@ static Rel rev_rel(Rel rel)
 // Allocate and initialize a `RelNode`.
 RelNode *rnode(Rel rel, TermNode *left, TermNode *right)
 {
-	RelNode *rnode = malloc(sizeof *rnode);
+	RelNode *rnode = arena_alloc(stmt_arena, sizeof *rnode);
 	*rnode = (RelNode){rel, left, right, NULL};
 	return rnode;
 }
@@ -42,55 +44,43 @@ bool norm_rel(RelNode *r)
 		return false;
 	}
 
-	long g = 0;
+	own_poly(&r->left);
+
+	// The GCD of the exact coefficients; dividing by it leaves coprime
+	// integers.
+	Coeff g = {ICOEFF_TERM, .hd.ival = 0};
 	for (TermNode *t = r->left; t; t = t->next) {
-		if (t->type != ICOEFF_TERM) {
-			continue;
-		}
-		if (!g) { // first ICOEFF_TERM
-			g = labs(t->hd.ival);
-		} else {
-			g = gcd(labs(t->hd.ival), g);
+		if (t->type != RCOEFF_TERM) {
+			Coeff c = coeff_of(t);
+			coeff_gcd(&g, &c);
 		}
 	}
 
-	if (g > 1) {
-		if (r->left->hd.ival < 0) {
-			g = -g;
-			r->rel = rev_rel(r->rel);
+	Coeff one = {ICOEFF_TERM, .hd.ival = 1};
+	Coeff hd = coeff_of(r->left);
+	bool neg = coeff_sgn(&hd) < 0;
+	if (neg) {
+		r->rel = rev_rel(r->rel);
+	}
+	if (!coeff_zero(&g) && cmp_coeff(&g, &one)) {
+		if (neg) {
+			coeff_neg(&g);
 		}
 		for (TermNode *t = r->left; t; t = t->next) {
-			switch (t->type) {
-			case ICOEFF_TERM:
-				t->hd.ival /= g;
-				break;
-			case RCOEFF_TERM:
-				t->hd.rval /= g;
-				break;
-			default:
-				fprintf(stderr, "unexpected node type %d\n",
-					t->type);
-				abort();
-			}
+			Coeff c = coeff_of(t);
+			coeff_div(&c, &g);
+			t->type = c.type;
+			t->hd = c.hd;
 		}
-	} else if (r->left->hd.ival < 0) {
-		r->rel = rev_rel(r->rel);
-
+	} else if (neg) {
 		for (TermNode *t = r->left; t; t = t->next) {
-			switch (t->type) {
-			case ICOEFF_TERM:
-				t->hd.ival *= -1;
-				break;
-			case RCOEFF_TERM:
-				t->hd.rval *= -1.0;
-				break;
-			default:
-				fprintf(stderr, "unexpected node type %d\n",
-					t->type);
-				abort();
-			}
+			Coeff c = coeff_of(t);
+			coeff_neg(&c);
+			t->type = c.type;
+			t->hd = c.hd;
 		}
 	}
+	free_coeff(&g);
 	return true;
 }
 
@@ -116,27 +106,28 @@ bool verify_nrel(const RelNode *r)
 void print_rel(const RelNode *r)
 {
 	static const char REL_SYM[][3] = {"", "=", ">", ">=", "<", "<="};
-	if (r->rel) {
+	for (;;) {
+		if (!r->rel) {
+			out_str("INCONSISTENT SYSTEM");
+			return;
+		}
 		print_poly(r->left);
-		printf("%s ", REL_SYM[r->rel]);
+		out_str(REL_SYM[r->rel]);
+		out_char(' ');
 		print_poly(r->right);
-		if (r->next) {
-			printf("\n   & ");
-			print_rel(r->next);
+		if (!(r = r->next)) {
+			break;
 		}
-	} else {
-		printf("INCONSISTENT SYSTEM");
+		out_str("\n   & ");
 	}
 }
 
-// Release `r` and all of the linked nodes along with their child nodes.
+// Release the polynomials of `r` and all of the linked nodes. The nodes
+// themselves are released along with `stmt_arena`.
 void free_rel(RelNode *r)
 {
-	if (!r) {
-		return;
+	for (; r; r = r->next) {
+		free_poly(r->left);
+		free_poly(r->right);
 	}
-	free_poly(r->left);
-	free_poly(r->right);
-	free_rel(r->next);
-	free(r);
 }
@@ -12,7 +12,7 @@ typedef struct RelNode {
 } RelNode;
 
 struct TermNode;
-// Allocate and initialize a `RelNode`.
+// Allocate and initialize a `RelNode` from `stmt_arena`.
 RelNode *rnode(Rel rel, struct TermNode *left, struct TermNode *right);
 
 Rel merge_rel(Rel r1, Rel r2);
@@ -26,7 +26,7 @@ bool verify_nrel(const RelNode *r);
 // Print an S-exp of the subtree under `r`.
 void print_rel(const RelNode *r);
 
-// Release `r` and all its child nodes.
+// Release the polynomials of `r` and all of the linked nodes.
 void free_rel(RelNode *r);
 
 #endif /* ifndef REL_H */
@@ -0,0 +1,614 @@
+#include "solve.h"
+#include "coeff.h"
+#include "out.h"
+#include "sym.h"
+#include "term.h"
+#include "util.h"
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+// Fourier-Motzkin elimination may produce quadratically many inequalities per
+// variable; once it would grow them beyond this many, it gives up, and the
+// system is left undecided.
+#define FM_MAX_ROWS 4096
+
+#define SLOTS_INIT 64
+
+// Whether every term of `p` is a constant or a variable with an exact
+// coefficient.
+static bool linear(const TermNode *p)
+{
+	for (; p; p = p->next) {
+		if (p->type == RCOEFF_TERM ||
+		    (p->u.vars && (p->u.vars->u.pow != 1 || p->u.vars->next))) {
+			return false;
+		}
+	}
+	return true;
+}
+
+// Return the term of the variable `sym` in the linear polynomial `p`, or
+// `NULL`.
+static const TermNode *term_of(const TermNode *p, int sym)
+{
+	for (; p; p = p->next) {
+		if (p->u.vars && p->u.vars->hd.sym == sym) {
+			return p;
+		}
+	}
+	return NULL;
+}
+
+// Return `p` multiplied by the coefficient `c`, which is taken over.
+static TermNode *scaled(const TermNode *p, Coeff *c)
+{
+	TermNode *q = poly_dup(p);
+	mul_poly(&q, coeff_term(c));
+	return q;
+}
+
+// Eliminate the variable `sym` from `r` by subtracting a multiple of `pivot`,
+// whose leading variable is `sym`, and normalize `r` again.
+static void eliminate(RelNode *r, const RelNode *pivot, int sym)
+{
+	const TermNode *t = term_of(r->left, sym);
+	if (!t) {
+		return;
+	}
+	Coeff f = coeff_of(t), c = coeff_of(pivot->left);
+	f = coeff_dup(&f);
+	coeff_div(&f, &c);
+	sub_poly(&r->left, scaled(pivot->left, &f));
+	norm_rel(r);
+}
+
+// Divide `p` by the GCD of its coefficients, keeping their signs.
+static void primitive(TermNode *p)
+{
+	Coeff g = {ICOEFF_TERM, .hd.ival = 0};
+	for (TermNode *t = p; t; t = t->next) {
+		Coeff c = coeff_of(t);
+		coeff_gcd(&g, &c);
+	}
+	Coeff one = {ICOEFF_TERM, .hd.ival = 1};
+	if (!coeff_zero(&g) && cmp_coeff(&g, &one)) {
+		for (TermNode *t = p; t; t = t->next) {
+			Coeff c = coeff_of(t);
+			coeff_div(&c, &g);
+			t->type = c.type;
+			t->hd = c.hd;
+		}
+	}
+	free_coeff(&g);
+}
+
+// An inequality `p > 0`, or `p >= 0` unless `strict`. `p` is `NULL` once the
+// inequality is eliminated.
+typedef struct Ineq {
+	TermNode *p;
+	bool strict;
+} Ineq;
+
+// The inequalities having a variable, and the number of them where it has a
+// positive and a negative coefficient. A `System` lists only the rows that have
+// had it, without the counts.
+typedef struct Occ {
+	int *v;
+	int len, cap;
+	int pos, neg;
+} Occ;
+
+// A system of inequalities, indexed by their variables.
+typedef struct Ineqs {
+	Ineq *v;
+	int len, cap;
+	int left;  // Inequalities not eliminated yet
+	Occ *occ;  // Indexed by symbols
+	int nsyms; // Length of `occ`
+} Ineqs;
+
+// Add `p > 0`, or `p >= 0` unless `strict`, to `s`, taking over `p`. Return
+// false if it has no variable and is false.
+static bool add_ineq(Ineqs *s, TermNode *p, bool strict)
+{
+	if (!p->u.vars) {
+		Coeff c = coeff_of(p);
+		int sgn = coeff_sgn(&c);
+		free_poly(p);
+		return strict ? sgn > 0 : sgn >= 0;
+	}
+	if (s->len == s->cap) {
+		s->cap = s->cap ? 2 * s->cap : 16;
+		s->v = realloc(s->v, s->cap * sizeof *s->v);
+	}
+	for (const TermNode *t = p; t && t->u.vars; t = t->next) {
+		Occ *o = &s->occ[t->u.vars->hd.sym];
+		if (o->len == o->cap) {
+			o->cap = o->cap ? 2 * o->cap : 4;
+			o->v = realloc(o->v, o->cap * sizeof *o->v);
+		}
+		o->v[o->len++] = s->len;
+		Coeff c = coeff_of(t);
+		++*(coeff_sgn(&c) > 0 ? &o->pos : &o->neg);
+	}
+	s->v[s->len++] = (Ineq){p, strict};
+	++s->left;
+	return true;
+}
+
+// Eliminate the `i`th inequality of `s`.
+static void drop_ineq(Ineqs *s, int i)
+{
+	TermNode *p = s->v[i].p;
+	for (const TermNode *t = p; t && t->u.vars; t = t->next) {
+		Coeff c = coeff_of(t);
+		--*(coeff_sgn(&c) > 0 ? &s->occ[t->u.vars->hd.sym].pos
+				      : &s->occ[t->u.vars->hd.sym].neg);
+	}
+	free_poly(p);
+	s->v[i].p = NULL;
+	--s->left;
+}
+
+static void free_ineqs(Ineqs *s)
+{
+	for (int i = 0; i < s->len; ++i) {
+		free_poly(s->v[i].p);
+	}
+	for (int i = 0; i < s->nsyms; ++i) {
+		free(s->occ[i].v);
+	}
+	free(s->v);
+	free(s->occ);
+}
+
+// Return a variable of `s` whose elimination adds no inequality, looking from
+// the symbol `from` on, or else the one adding the fewest, or -1 if none is
+// left.
+static int pick_var(const Ineqs *s, int from)
+{
+	int best = -1;
+	long cost = 0;
+	for (int i = 0; i < s->nsyms; ++i) {
+		int sym = (from + i) % s->nsyms;
+		long pos = s->occ[sym].pos, neg = s->occ[sym].neg;
+		long c = pos * neg - pos - neg;
+		if ((pos || neg) && (best < 0 || c < cost)) {
+			best = sym;
+			cost = c;
+			if (cost <= 0) {
+				break;
+			}
+		}
+	}
+	return best;
+}
+
+// Whether the inequalities `s` have a real solution, by eliminating their
+// variables one by one. Set `*undecided` and return true if there would be too
+// many inequalities to tell.
+static bool feasible(Ineqs *s, bool *undecided)
+{
+	int sym = 0;
+	while ((sym = pick_var(s, sym)) >= 0) {
+		Occ *o = &s->occ[sym];
+		// Give up if there would be too many more inequalities.
+		long len = s->left + (long)o->pos * o->neg - o->pos - o->neg;
+		if (len > s->left && len > FM_MAX_ROWS) {
+			*undecided = true;
+			return true;
+		}
+		int *lo = malloc(o->pos * sizeof *lo), nlo = 0;
+		int *hi = malloc(o->neg * sizeof *hi), nhi = 0;
+		for (int i = 0; i < o->len; ++i) {
+			const TermNode *t = s->v[o->v[i]].p;
+			if (!t) { // Eliminated already
+				continue;
+			}
+			Coeff c = coeff_of(term_of(t, sym));
+			if (coeff_sgn(&c) > 0) {
+				lo[nlo++] = o->v[i];
+			} else {
+				hi[nhi++] = o->v[i];
+			}
+		}
+		// `a x + p >= 0` and `-b x + q >= 0` for positive `a` and `b`
+		// are satisfiable for `x` iff `b p + a q >= 0`.
+		bool sat = true;
+		for (int i = 0; sat && i < nlo; ++i) {
+			for (int j = 0; sat && j < nhi; ++j) {
+				const Ineq *l = &s->v[lo[i]], *h = &s->v[hi[j]];
+				Coeff a = coeff_of(term_of(l->p, sym));
+				Coeff b = coeff_of(term_of(h->p, sym));
+				a = coeff_dup(&a);
+				b = coeff_dup(&b);
+				coeff_neg(&b);
+				TermNode *p = scaled(l->p, &b);
+				add_poly(&p, scaled(h->p, &a));
+				primitive(p);
+				sat = add_ineq(s, p, l->strict || h->strict);
+			}
+		}
+		for (int i = 0; i < nlo; ++i) {
+			drop_ineq(s, lo[i]);
+		}
+		for (int i = 0; i < nhi; ++i) {
+			drop_ineq(s, hi[i]);
+		}
+		free(lo);
+		free(hi);
+		o = &s->occ[sym];
+		free(o->v);
+		*o = (Occ){0};
+		if (!sat) {
+			return false;
+		}
+	}
+	return true;
+}
+
+
+// The state of a relation of a system.
+typedef enum RowState {
+	DROPPED, // Released, or merged into another relation
+	TABLED,	 // Looked up by its left side for merging
+	PENDING, // An equality to be solved
+	PIVOT,	 // An equality solved for its leading variable
+} RowState;
+
+// A relation of a system.
+typedef struct Row {
+	RelNode *r;
+	unsigned long hash; // Of the left side, while `TABLED`
+	RowState state;
+	bool linear;
+} Row;
+
+struct System {
+	Row *rows;
+	int len, cap;
+	// The rows of each symbol: the equality solved for it, or -1, and the
+	// linear relations that have had it.
+	int *pivot;
+	Occ *occ;
+	int nsyms;
+	// An open-addressing hash table of the `TABLED` rows, kept at most half
+	// full counting the removed ones. An empty slot holds -1, and a removed
+	// one -2.
+	int *slots;
+	int nslots, nused;
+	int *pending; // Stack of the `PENDING` rows
+	int npending;
+	RelNode *trivial; // The first relation reduced to a true one
+	bool sat;
+};
+
+System *new_system(void)
+{
+	System *s = calloc(1, sizeof *s);
+	s->sat = true;
+	return s;
+}
+
+void free_system(System *s)
+{
+	for (int i = 0; i < s->len; ++i) {
+		if (s->rows[i].state != DROPPED) {
+			free_rel(s->rows[i].r);
+		}
+	}
+	for (int i = 0; i < s->nsyms; ++i) {
+		free(s->occ[i].v);
+	}
+	free_rel(s->trivial);
+	free(s->rows);
+	free(s->pivot);
+	free(s->occ);
+	free(s->slots);
+	free(s->pending);
+	free(s);
+}
+
+// Make room in `s` for the symbols of `p`.
+static void reserve(System *s, const TermNode *p)
+{
+	int max = -1;
+	for (; p && p->u.vars; p = p->next) {
+		if (p->u.vars->hd.sym > max) {
+			max = p->u.vars->hd.sym;
+		}
+	}
+	if (max < s->nsyms) {
+		return;
+	}
+	int n = s->nsyms ? 2 * s->nsyms : 16;
+	while (n <= max) {
+		n *= 2;
+	}
+	s->pivot = realloc(s->pivot, n * sizeof *s->pivot);
+	s->occ = realloc(s->occ, n * sizeof *s->occ);
+	for (int i = s->nsyms; i < n; ++i) {
+		s->pivot[i] = -1;
+		s->occ[i] = (Occ){0};
+	}
+	s->nsyms = n;
+}
+
+// Record that the linear row `i` of `s` has the variables it has now.
+static void note_vars(System *s, int i)
+{
+	for (const TermNode *t = s->rows[i].r->left; t && t->u.vars;
+	     t = t->next) {
+		Occ *o = &s->occ[t->u.vars->hd.sym];
+		if (o->len && o->v[o->len - 1] == i) {
+			continue;
+		}
+		if (o->len == o->cap) {
+			o->cap = o->cap ? 2 * o->cap : 4;
+			o->v = realloc(o->v, o->cap * sizeof *o->v);
+		}
+		o->v[o->len++] = i;
+	}
+}
+
+// Eliminate from `r` the variables solved by the equalities of `s` other than
+// `r` itself. Each of them brings in only lower variables.
+static void substitute(const System *s, RelNode *r)
+{
+	const TermNode *t = r->left;
+	while (t && t->u.vars) {
+		int i = s->pivot[t->u.vars->hd.sym];
+		if (i >= 0 && s->rows[i].r != r) {
+			eliminate(r, s->rows[i].r, t->u.vars->hd.sym);
+			t = r->left;
+		} else {
+			t = t->next;
+		}
+	}
+}
+
+static void rehash(System *s)
+{
+	int live = 0;
+	for (int i = 0; i < s->nslots; ++i) {
+		live += s->slots[i] >= 0;
+	}
+	int nslots = SLOTS_INIT;
+	while (nslots < 4 * (live + 1)) {
+		nslots *= 2;
+	}
+	int *slots = malloc(nslots * sizeof *slots);
+	for (int i = 0; i < nslots; ++i) {
+		slots[i] = -1;
+	}
+	unsigned long mask = nslots - 1;
+	for (int i = 0; i < s->nslots; ++i) {
+		int k = s->slots[i];
+		if (k >= 0) {
+			unsigned long j = s->rows[k].hash & mask;
+			while (slots[j] >= 0) {
+				j = (j + 1) & mask;
+			}
+			slots[j] = k;
+		}
+	}
+	free(s->slots);
+	s->slots = slots;
+	s->nslots = nslots;
+	s->nused = live;
+}
+
+// Put the row `i` of `s` in the table, or merge it into the row there with the
+// same left side. Return the row it is in.
+static int table_row(System *s, int i)
+{
+	if (2 * (s->nused + 1) > s->nslots) {
+		rehash(s);
+	}
+	Row *row = &s->rows[i];
+	unsigned long h = poly_hash(row->r->left), mask = s->nslots - 1;
+	unsigned long j = h & mask;
+	long removed = -1; // The first removed slot seen
+	int k;
+	while ((k = s->slots[j]) != -1) {
+		if (k == -2) {
+			if (removed < 0) {
+				removed = j;
+			}
+		} else if (s->rows[k].hash == h &&
+			   !poly_cmp(s->rows[k].r->left, row->r->left)) {
+			RelNode *r = s->rows[k].r;
+			r->rel = merge_rel(r->rel, row->r->rel);
+			s->sat = s->sat && r->rel;
+			free_rel(row->r);
+			row->state = DROPPED;
+			return k;
+		}
+		j = (j + 1) & mask;
+	}
+	if (removed >= 0) {
+		j = removed;
+	} else {
+		++s->nused;
+	}
+	s->slots[j] = i;
+	row->hash = h;
+	row->state = TABLED;
+	return i;
+}
+
+// Take the row `i` of `s` out of the table.
+static void untable_row(System *s, int i)
+{
+	unsigned long mask = s->nslots - 1, j = s->rows[i].hash & mask;
+	while (s->slots[j] != i) {
+		j = (j + 1) & mask;
+	}
+	s->slots[j] = -2;
+}
+
+// Settle the linear row `i` of `s`, which has no solved variable: drop it once
+// it is constant, or else solve it if it is an equality, or table it.
+static void settle(System *s, int i)
+{
+	Row *row = &s->rows[i];
+	if (!row->r->left->u.vars) {
+		s->sat = s->sat && verify_nrel(row->r);
+		if (s->trivial) {
+			free_rel(row->r);
+		} else {
+			s->trivial = row->r;
+		}
+		row->state = DROPPED;
+		return;
+	}
+	if (row->r->rel != EQ) {
+		i = table_row(s, i);
+		row = &s->rows[i];
+		if (row->r->rel != EQ) {
+			return;
+		}
+		// Opposite inequalities make an equality.
+		untable_row(s, i);
+	}
+	s->pending[s->npending++] = i;
+	row->state = PENDING;
+}
+
+// Solve the pending equality `i` of `s` for its leading variable, and
+// eliminate the variable from the other linear rows but the equalities solved,
+// which are left in row echelon form.
+static void solve_row(System *s, int i)
+{
+	const RelNode *r = s->rows[i].r;
+	int sym = r->left->u.vars->hd.sym;
+	s->pivot[sym] = i;
+	s->rows[i].state = PIVOT;
+	Occ o = s->occ[sym];
+	s->occ[sym] = (Occ){0};
+	for (int j = 0; s->sat && j < o.len; ++j) {
+		int k = o.v[j];
+		Row *row = &s->rows[k];
+		if (row->state == DROPPED || row->state == PIVOT ||
+		    !term_of(row->r->left, sym)) {
+			continue;
+		}
+		if (row->state == TABLED) {
+			untable_row(s, k);
+		}
+		eliminate(row->r, r, sym);
+		note_vars(s, k);
+		if (row->state == TABLED) {
+			settle(s, k);
+		}
+	}
+	free(o.v);
+}
+
+bool add_rel(System *s, RelNode *r)
+{
+	if (!s->sat) {
+		free_rel(r);
+		return false;
+	}
+	if (s->len == s->cap) {
+		s->cap = s->cap ? 2 * s->cap : 16;
+		s->rows = realloc(s->rows, s->cap * sizeof *s->rows);
+		s->pending =
+		    realloc(s->pending, s->cap * sizeof *s->pending);
+	}
+	int i = s->len++;
+	s->rows[i] = (Row){.r = r, .linear = linear(r->left)};
+	if (r->left->u.vars && !s->rows[i].linear) {
+		table_row(s, i);
+		return s->sat;
+	}
+	reserve(s, r->left);
+	substitute(s, r);
+	if (r->left->u.vars) {
+		note_vars(s, i);
+	}
+	settle(s, i);
+	while (s->sat && s->npending) {
+		int k = s->pending[--s->npending];
+		if (s->rows[k].r->left->u.vars) {
+			solve_row(s, k);
+		} else {
+			settle(s, k);
+		}
+	}
+	return s->sat;
+}
+
+// Order relations by their left sides, from the highest one.
+static int rel_cmp(const void *r1, const void *r2)
+{
+	return poly_cmp((*(RelNode *const *)r2)->left,
+			(*(RelNode *const *)r1)->left);
+}
+
+RelNode *solve(System *s)
+{
+	RelNode **rs = malloc(s->len * sizeof *rs);
+	int n = 0;
+	// Reduce the equalities from the one of the lowest leading variable, so
+	// that each is substituted by the equalities reduced already.
+	for (int i = 0; i < s->len; ++i) {
+		if (s->rows[i].state == PIVOT) {
+			rs[n++] = s->rows[i].r;
+		}
+	}
+	qsort(rs, n, sizeof *rs, rel_cmp);
+	for (int i = n; s->sat && i--;) {
+		substitute(s, rs[i]);
+	}
+
+	Ineqs ineqs = {.nsyms = s->nsyms,
+		       .occ = calloc(s->nsyms, sizeof *ineqs.occ)};
+	for (int i = 0; s->sat && i < s->len; ++i) {
+		const Row *row = &s->rows[i];
+		if (row->state == TABLED && row->linear) {
+			TermNode *p = poly_dup(row->r->left);
+			if (row->r->rel == LT || row->r->rel == LE) {
+				neg_poly(&p);
+			}
+			add_ineq(&ineqs, p,
+				 row->r->rel == GT || row->r->rel == LT);
+		}
+	}
+	bool undecided = false;
+	s->sat = s->sat && feasible(&ineqs, &undecided);
+	free_ineqs(&ineqs);
+	if (s->sat && undecided) {
+		out_flush();
+		fprintf(stmt_err, "Too many inequalities to decide whether "
+				  "they have a solution.\n");
+	}
+
+	n = 0;
+	for (int i = 0; i < s->len; ++i) {
+		if (s->rows[i].state != DROPPED) {
+			rs[n++] = s->rows[i].r;
+			s->rows[i].state = DROPPED;
+		}
+	}
+	qsort(rs, n, sizeof *rs, rel_cmp);
+	RelNode *hd = NULL, **tail = &hd;
+	for (int i = 0; i < n; ++i) {
+		*tail = rs[i];
+		tail = &rs[i]->next;
+	}
+	*tail = NULL;
+	free(rs);
+	if (!hd) { // Every relation is true.
+		hd = s->trivial;
+		s->trivial = NULL;
+	}
+	if (!s->sat) {
+		free_rel(hd);
+		hd = rnode(0, NULL, NULL);
+	}
+	free_system(s);
+	return hd;
+}
@@ -0,0 +1,32 @@
+#ifndef SOLVE_H
+#define SOLVE_H
+
+#include "rel.h"
+
+// A system of relations, reduced as its relations are added. Relations between
+// the same polynomial are merged, looking them up by the hash of the
+// polynomial. The relations whose terms are all linear with exact coefficients
+// are reduced: each equality is solved for its leading variable, which is then
+// eliminated from the other linear relations, and a relation reduced to a
+// constant one is dropped if true. Other relations are kept as they are. Once
+// all are added, the linear inequalities left are checked for a real solution
+// by Fourier-Motzkin elimination. If that would take too many inequalities, a
+// warning is printed to `stmt_err` instead of a verdict.
+typedef struct System System;
+
+// Return an empty system.
+System *new_system(void);
+
+// Add the normalized relation `r` to `s`, taking it over, and reduce `s`.
+// Return false once `s` is found to have no solution.
+bool add_rel(System *s, RelNode *r);
+
+// Return the relations of `s`, sorted, and release `s`. The result is an
+// inconsistent relation if `s` has no solution, or the first relation reduced
+// to a true one if no other is left.
+RelNode *solve(System *s);
+
+// Release `s`.
+void free_system(System *s);
+
+#endif /* ifndef SOLVE_H */
@@ -0,0 +1,106 @@
+#define _POSIX_C_SOURCE 200809L // clock_gettime
+#include "stats.h"
+#include "out.h"
+#include "util.h"
+#include <pthread.h>
+#include <stdio.h>
+#include <time.h>
+
+bool stats;
+_Thread_local StmtStats stmt_stats;
+
+static const char *OP_NAMES[] = {"add", "sub", "mul", "div", "pow", "neg"};
+
+// The summary of the statements evaluated so far; `peak` is the largest peak
+// of a statement.
+static StmtStats total;
+static long nstmts;
+static pthread_mutex_t total_lock = PTHREAD_MUTEX_INITIALIZER;
+
+// Return the time in nanoseconds since an arbitrary point.
+long stats_clock(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1000000000L + ts.tv_nsec;
+}
+
+// Start the statistics of the statement to be parsed next.
+void begin_parse(void)
+{
+	if (stats) {
+		stmt_stats = (StmtStats){.parse_ns = stats_clock()};
+	}
+}
+
+// Record the end of parsing the current statement, on line `line`.
+void end_parse(int line)
+{
+	stmt_stats.line = line;
+	if (stats) {
+		stmt_stats.parse_ns = stats_clock() - stmt_stats.parse_ns;
+	}
+}
+
+// Start timing the evaluation of the current statement.
+void begin_eval(void)
+{
+	if (stats) {
+		stmt_stats.eval_ns = stats_clock();
+	}
+}
+
+// Print `s` to `f`, labeled `label`.
+static void print(FILE *f, const char *label, const StmtStats *s)
+{
+	fprintf(f, "stats: %s: parse %ld us, eval %ld us (", label,
+		s->parse_ns / 1000, s->eval_ns / 1000);
+	for (int op = 0; op <= NEG; ++op) {
+		fprintf(f, "%s%s %ld", op ? ", " : "", OP_NAMES[op],
+			s->op_ns[op] / 1000);
+	}
+	fprintf(f, "), terms %ld allocated, %ld freed, %ld peak, %ld output\n",
+		s->allocs, s->frees, s->peak, s->out_terms);
+}
+
+// Record the end of the evaluation of the current statement, whose result has
+// `out_terms` terms, print its statistics to `stmt_err`, and add them to the
+// summary.
+void end_eval(long out_terms)
+{
+	if (!stats) {
+		return;
+	}
+	StmtStats *s = &stmt_stats;
+	s->eval_ns = stats_clock() - s->eval_ns;
+	s->out_terms = out_terms;
+	char label[32];
+	snprintf(label, sizeof label, "line %d", s->line);
+	out_flush();
+	print(stmt_err, label, s);
+
+	pthread_mutex_lock(&total_lock);
+	++nstmts;
+	total.parse_ns += s->parse_ns;
+	total.eval_ns += s->eval_ns;
+	for (int op = 0; op <= NEG; ++op) {
+		total.op_ns[op] += s->op_ns[op];
+	}
+	total.allocs += s->allocs;
+	total.frees += s->frees;
+	if (s->peak > total.peak) {
+		total.peak = s->peak;
+	}
+	total.out_terms += s->out_terms;
+	pthread_mutex_unlock(&total_lock);
+}
+
+// Print the summary of the statements evaluated to `stderr`.
+void print_stats(void)
+{
+	if (stats) {
+		char label[32];
+		snprintf(label, sizeof label, "%ld statements", nstmts);
+		print(stderr, label, &total);
+	}
+}
@@ -0,0 +1,65 @@
+#ifndef STATS_H
+#define STATS_H
+
+#include "ast.h"
+#include <stdbool.h>
+
+// Statistics of the cost of each statement, collected with `-s`. Counting is
+// guarded by `stats`, so that it costs a predictable branch when turned off.
+
+typedef struct StmtStats {
+	int line; // Recorded even without `stats`, to name generated functions
+	long parse_ns, eval_ns;
+	long op_ns[NEG + 1]; // Time spent in each operation, besides operands
+	long allocs, frees;  // `TermNode`s allocated and released
+	long live, peak;     // `TermNode`s allocated and not yet released
+	long out_terms;	     // Terms of the result
+} StmtStats;
+
+// Whether statistics are collected, false by default.
+extern bool stats;
+
+// The statistics of the statement being parsed or evaluated.
+extern _Thread_local StmtStats stmt_stats;
+
+// Return the time in nanoseconds since an arbitrary point.
+long stats_clock(void);
+
+// Count a `TermNode` allocated.
+static inline void count_alloc(void)
+{
+	if (stats) {
+		++stmt_stats.allocs;
+		if (++stmt_stats.live > stmt_stats.peak) {
+			stmt_stats.peak = stmt_stats.live;
+		}
+	}
+}
+
+// Count a `TermNode` released.
+static inline void count_free(void)
+{
+	if (stats) {
+		++stmt_stats.frees;
+		--stmt_stats.live;
+	}
+}
+
+// Start the statistics of the statement to be parsed next.
+void begin_parse(void);
+
+// Record the end of parsing the current statement, on line `line`.
+void end_parse(int line);
+
+// Start timing the evaluation of the current statement.
+void begin_eval(void);
+
+// Record the end of the evaluation of the current statement, whose result has
+// `out_terms` terms, print its statistics to `stmt_err`, and add them to the
+// summary.
+void end_eval(long out_terms);
+
+// Print the summary of the statements evaluated to `stderr`.
+void print_stats(void);
+
+#endif /* ifndef STATS_H */
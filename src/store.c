@@ -0,0 +1,373 @@
+#define _POSIX_C_SOURCE 200809L // fstat
+#include "store.h"
+#include "bigint.h"
+#include "coeff.h"
+#include "mono.h"
+#include "pool.h"
+#include "sym.h"
+#include "term.h"
+#include "vec.h"
+#include <fcntl.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#define MAGIC "POLYENV1"
+#define WORD sizeof(uint64_t)
+
+// Write `n` bytes at `p` to `f`, padded to a word.
+static void put(FILE *f, const void *p, size_t n)
+{
+	static const char pad[WORD];
+	fwrite(p, 1, n, f);
+	fwrite(pad, 1, -n % WORD, f);
+}
+
+static void put_word(FILE *f, uint64_t w) { put(f, &w, WORD); }
+
+static void put_coeff(FILE *f, const Coeff *c)
+{
+	put_word(f, c->type);
+	switch (c->type) {
+	case ICOEFF_TERM:
+		put(f, &c->hd.ival, WORD);
+		break;
+	case RCOEFF_TERM:
+		put(f, &c->hd.rval, WORD);
+		break;
+	case BCOEFF_TERM:
+		put_word(f, c->hd.big->neg);
+		put_word(f, c->hd.big->len);
+		put(f, c->hd.big->limbs, c->hd.big->len * sizeof(uint32_t));
+		break;
+	case QCOEFF_TERM:
+		put_coeff(f, &c->hd.rat->num);
+		put_coeff(f, &c->hd.rat->den);
+		break;
+	default:
+		fprintf(stderr, "unexpected node type %d\n", c->type);
+		abort();
+	}
+}
+
+static void put_poly(FILE *f, int sym, const TermNode *p)
+{
+	MonoLayout *lay = new_layout(p, NULL, max_pow(p));
+	PolyVec v;
+	vec_from_poly(&v, lay, p);
+	put_word(f, sym);
+	put_word(f, v.len);
+	put_word(f, lay->nvars);
+	put_word(f, lay->bits);
+	put_word(f, lay->nwords);
+	for (int i = 0; i < lay->nvars; ++i) {
+		put_word(f, lay->syms[i]);
+	}
+	put(f, v.monos, v.len * lay->nwords * WORD);
+	for (size_t i = 0; i < v.len; ++i) {
+		put_coeff(f, &v.coeffs[i]);
+	}
+	free_vec(&v);
+	free_layout(lay);
+}
+
+// Save the variables assigned in `env` to the file `path`.
+// Every symbol is saved, and the variables in the order of the table.
+bool save_env(const Env *env, const char *path)
+{
+	FILE *f = fopen(path, "wb");
+	if (!f) {
+		return false;
+	}
+	int nsyms = sym_count(), nvars = 0;
+	for (int i = 0; i < env->nslots; ++i) {
+		nvars += env->slots[i].poly != NULL;
+	}
+	put(f, MAGIC, WORD);
+	put_word(f, nsyms);
+	put_word(f, nvars);
+	for (int sym = 0; sym < nsyms; ++sym) {
+		const char *name = sym_name(sym);
+		put_word(f, strlen(name));
+		put(f, name, strlen(name));
+	}
+	for (int i = 0; i < env->nslots; ++i) {
+		if (env->slots[i].poly) {
+			put_poly(f, env->slots[i].sym, env->slots[i].poly);
+		}
+	}
+	bool ok = !ferror(f);
+	return fclose(f) == 0 && ok;
+}
+
+// The part of a mapped file yet to be read.
+typedef struct Reader {
+	const char *p, *end;
+} Reader;
+
+// Return the next `n` bytes of `r`, skipping the padding to a word, or `NULL`
+// if the file is too short.
+static const void *take(Reader *r, uint64_t n)
+{
+	uint64_t size = n + -n % WORD;
+	if (size < n || size > (uint64_t)(r->end - r->p)) {
+		return NULL;
+	}
+	const void *p = r->p;
+	r->p += size;
+	return p;
+}
+
+// Return the next `n` words of `r`, or `NULL` if the file is too short.
+static const uint64_t *take_words(Reader *r, uint64_t n)
+{
+	return n > UINT64_MAX / WORD ? NULL : take(r, n * WORD);
+}
+
+// Read a coefficient from `r` to `c`, which must be non-zero and kept in the
+// narrowest type holding its value, as by the operations on coefficients.
+// Only integers are read if `integer`.
+static bool take_coeff(Reader *r, Coeff *c, bool integer)
+{
+	const uint64_t *w = take_words(r, 1);
+	if (!w) {
+		return false;
+	}
+	uint64_t type = *w;
+	switch (type) {
+	case ICOEFF_TERM:
+	case RCOEFF_TERM:
+		if ((type == RCOEFF_TERM && integer) ||
+		    !(w = take_words(r, 1))) {
+			return false;
+		}
+		c->type = type;
+		memcpy(&c->hd, w, WORD);
+		return !coeff_zero(c);
+	case BCOEFF_TERM: {
+		const uint64_t *hd = take_words(r, 2);
+		const uint32_t *limbs;
+		if (!hd || hd[0] > 1 || !hd[1] ||
+		    hd[1] > SIZE_MAX / sizeof *limbs ||
+		    !(limbs = take(r, hd[1] * sizeof *limbs)) ||
+		    !limbs[hd[1] - 1]) {
+			return false;
+		}
+		BigInt *b = malloc(sizeof *b + hd[1] * sizeof *limbs);
+		b->neg = hd[0];
+		b->len = hd[1];
+		memcpy(b->limbs, limbs, hd[1] * sizeof *limbs);
+		long v;
+		if (big_to_long(b, &v)) {
+			free(b);
+			return false;
+		}
+		*c = (Coeff){BCOEFF_TERM, .hd.big = b};
+		return true;
+	}
+	case QCOEFF_TERM: {
+		Coeff num, den;
+		if (integer || !take_coeff(r, &num, true)) {
+			return false;
+		}
+		if (!take_coeff(r, &den, true)) {
+			free_coeff(&num);
+			return false;
+		}
+		// The denominator is greater than 1 and coprime to the
+		// numerator.
+		Coeff one = {ICOEFF_TERM, .hd.ival = 1}, g = coeff_dup(&num);
+		coeff_gcd(&g, &den);
+		bool ok = cmp_coeff(&den, &one) > 0 && !cmp_coeff(&g, &one);
+		free_coeff(&g);
+		if (!ok) {
+			free_coeff(&num);
+			free_coeff(&den);
+			return false;
+		}
+		Rat *q = malloc(sizeof *q);
+		*q = (Rat){num, den};
+		*c = (Coeff){QCOEFF_TERM, .hd.rat = q};
+		return true;
+	}
+	default:
+		return false;
+	}
+}
+
+// A variable read from a file, whose monomials are still in the mapping.
+typedef struct Loaded {
+	int sym;
+	MonoLayout lay;
+	PolyVec v;
+} Loaded;
+
+static void free_loaded(Loaded *var)
+{
+	var->v.monos = NULL;
+	free_vec(&var->v);
+	free(var->lay.syms);
+}
+
+// Check that the variables of `lay` are distinct and sorted, and that the
+// monomials of `v` are in descending order, with no bits set outside of the
+// fields of the layout.
+static bool valid_monos(const MonoLayout *lay, const PolyVec *v)
+{
+	for (int i = 1; i < lay->nvars; ++i) {
+		if (sym_cmp(lay->syms[i - 1], lay->syms[i]) >= 0) {
+			return false;
+		}
+	}
+	int per_word = 64 / lay->bits, nwords = lay->nwords;
+	for (size_t i = 0; i < v->len; ++i) {
+		const uint64_t *m = &v->monos[i * nwords];
+		for (int j = 0; j < nwords; ++j) {
+			int n = lay->nvars - j * per_word;
+			int used = lay->bits * (n < per_word ? n : per_word);
+			if (used < 64 && m[j] << used) {
+				return false;
+			}
+		}
+		if (i && mono_cmp(m - nwords, m, nwords) <= 0) {
+			return false;
+		}
+	}
+	return true;
+}
+
+// Read a variable from `r` to `var`. `syms` maps the symbols of the file to the
+// ones of this run.
+static bool take_var(Reader *r, const int *syms, uint64_t nsyms, Loaded *var)
+{
+	const uint64_t *hd = take_words(r, 5);
+	if (!hd || hd[0] >= nsyms || hd[2] > nsyms || !hd[3] || hd[3] > 63) {
+		return false;
+	}
+	uint64_t nterms = hd[1], nvars = hd[2], per_word = 64 / hd[3];
+	int nwords = (nvars + per_word - 1) / per_word;
+	const uint64_t *vars = take_words(r, nvars);
+	if (hd[4] != (uint64_t)nwords || !vars ||
+	    (nwords && nterms > UINT64_MAX / nwords)) {
+		return false;
+	}
+	const uint64_t *monos = take_words(r, nterms * nwords);
+	if (!monos || nterms > (uint64_t)(r->end - r->p) / WORD) {
+		return false;
+	}
+
+	var->sym = syms[hd[0]];
+	var->lay = (MonoLayout){nvars, malloc(nvars * sizeof(int)), hd[3],
+				nwords};
+	// The monomials are only read, straight from the mapping.
+	var->v = (PolyVec){0, nterms, malloc(nterms * sizeof(Coeff)),
+			   (uint64_t *)monos, &var->lay};
+	for (uint64_t i = 0; i < nvars; ++i) {
+		if (vars[i] >= nsyms) {
+			free_loaded(var);
+			return false;
+		}
+		var->lay.syms[i] = syms[vars[i]];
+	}
+	var->v.len = nterms;
+	if (!valid_monos(&var->lay, &var->v)) {
+		var->v.len = 0;
+		free_loaded(var);
+		return false;
+	}
+	for (var->v.len = 0; var->v.len < nterms; ++var->v.len) {
+		if (!take_coeff(r, &var->v.coeffs[var->v.len], false)) {
+			free_loaded(var);
+			return false;
+		}
+	}
+	return true;
+}
+
+// Assign `var` in `env`, and release it.
+static void put_loaded(Loaded *var, Env *env)
+{
+	declare_var(var->sym, env);
+	Pool *pool = term_pool;
+	term_pool = &env->terms;
+	TermNode *p = vec_to_poly(&var->v);
+	if (!put_var(var->sym, p, env)) {
+		fprintf(stderr, "Variable %s is already defined.\n",
+			sym_name(var->sym));
+		free_poly(p);
+	}
+	term_pool = pool;
+	free_loaded(var);
+}
+
+// Read the variables of `r`, and assign them in `env` only if all of them are
+// read.
+static bool take_env(Reader *r, Env *env)
+{
+	const char *magic = take(r, WORD);
+	const uint64_t *hd = take_words(r, 2);
+	if (!magic || memcmp(magic, MAGIC, WORD) || !hd ||
+	    hd[0] > (uint64_t)(r->end - r->p) / WORD ||
+	    hd[1] > (uint64_t)(r->end - r->p) / (5 * WORD)) {
+		return false;
+	}
+	uint64_t nsyms = hd[0], nvars = hd[1];
+	int *syms = malloc(nsyms * sizeof *syms);
+	bool ok = true;
+	for (uint64_t i = 0; i < nsyms && ok; ++i) {
+		const uint64_t *len = take_words(r, 1);
+		const char *name;
+		if (!len || !*len || !(name = take(r, *len))) {
+			ok = false;
+			break;
+		}
+		char *s = strndup(name, *len);
+		syms[i] = intern(s);
+		free(s);
+	}
+	Loaded *vars = malloc(nvars * sizeof *vars);
+	uint64_t n = 0;
+	for (; n < nvars && ok; ++n) {
+		ok = take_var(r, syms, nsyms, &vars[n]);
+	}
+	if (!ok && n) {
+		--n; // The last variable failed, releasing itself.
+	}
+	for (uint64_t i = 0; i < n; ++i) {
+		if (ok) {
+			put_loaded(&vars[i], env);
+		} else {
+			free_loaded(&vars[i]);
+		}
+	}
+	free(vars);
+	free(syms);
+	return ok;
+}
+
+// Assign the variables saved in the file `path` in `env`.
+bool load_env(Env *env, const char *path)
+{
+	int fd = open(path, O_RDONLY);
+	if (fd < 0) {
+		return false;
+	}
+	struct stat st;
+	if (fstat(fd, &st) || !st.st_size) {
+		close(fd);
+		return false;
+	}
+	char *base = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+	close(fd);
+	if (base == MAP_FAILED) {
+		return false;
+	}
+	Reader r = {base, base + st.st_size};
+	bool ok = take_env(&r, env);
+	munmap(base, st.st_size);
+	return ok;
+}
@@ -0,0 +1,31 @@
+#ifndef STORE_H
+#define STORE_H
+
+#include "asgn.h"
+#include <stdbool.h>
+
+// Environments are saved in a binary format of native-endian 64-bit words:
+//
+//   header:  "POLYENV1", number of symbols, number of variables
+//   symbols: per symbol, the length of its name and the name, padded to a word
+//   per variable:
+//     its symbol, number of terms, number of variables of its layout, bits of
+//     an exponent field, words of a packed monomial
+//     the symbols of the layout, sorted by name
+//     the packed monomials of the terms, as in a `PolyVec`
+//     the coefficients of the terms, each a type followed by its value
+//
+// Symbols are referred to by their index in the file. Loading maps the file
+// into memory, and builds the polynomials from the packed monomials in place.
+// The file is checked to hold polynomials as they are kept in memory, i.e.,
+// with sorted distinct monomials and non-zero coefficients in their narrowest
+// types, and rationals in lowest terms.
+
+// Save the variables assigned in `env` to the file `path`.
+bool save_env(const Env *env, const char *path);
+
+// Assign the variables saved in the file `path` in `env`. Nothing is assigned
+// if the file is malformed.
+bool load_env(Env *env, const char *path);
+
+#endif /* ifndef STORE_H */
@@ -0,0 +1,156 @@
+#include "sym.h"
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define SLOTS_INIT 64
+
+// Ranks are spaced `RANK_GAP` apart around the middle of their range, so that a
+// new symbol takes a rank between those of its neighbors, and the ranks are
+// renumbered only when there is none left between them.
+#define RANK_GAP ((uint64_t)1 << 32)
+#define RANK_MID ((uint64_t)1 << 63)
+
+// `names[id]` is the name of the symbol `id`. `order` lists the ids sorted by
+// name, and `rank[id]` increases with the position of `id` in `order`.
+// `slots` is an open-addressing hash table of ids keyed by name; an empty slot
+// holds -1. The table is kept at most half full.
+static struct {
+	char **names;
+	uint64_t *rank;
+	int *order;
+	int len, cap;
+	int *slots;
+	int nslots;
+} tab;
+
+static unsigned long hash(const char *s)
+{
+	// FNV-1a
+	unsigned long h = 14695981039346656037UL;
+	for (; *s; ++s) {
+		h = (h ^ (unsigned char)*s) * 1099511628211UL;
+	}
+	return h;
+}
+
+static void rehash(int nslots)
+{
+	free(tab.slots);
+	tab.slots = malloc(nslots * sizeof *tab.slots);
+	tab.nslots = nslots;
+	for (int i = 0; i < nslots; ++i) {
+		tab.slots[i] = -1;
+	}
+	for (int id = 0; id < tab.len; ++id) {
+		unsigned long i = hash(tab.names[id]) & (nslots - 1);
+		while (tab.slots[i] >= 0) {
+			i = (i + 1) & (nslots - 1);
+		}
+		tab.slots[i] = id;
+	}
+}
+
+// Space the ranks of the `n` symbols in `order` `RANK_GAP` apart.
+static void renumber(int n)
+{
+	for (int i = 0; i < n; ++i) {
+		tab.rank[tab.order[i]] = RANK_MID + (i - n / 2) * RANK_GAP;
+	}
+}
+
+// Insert `id` into `order` keeping it sorted, and rank it between its
+// neighbors.
+static void insert_order(int id)
+{
+	int lo = 0, hi = id; // `order` holds `id` entries so far.
+	while (lo < hi) {
+		int mid = (lo + hi) / 2;
+		if (strcmp(tab.names[tab.order[mid]], tab.names[id]) < 0) {
+			lo = mid + 1;
+		} else {
+			hi = mid;
+		}
+	}
+	memmove(&tab.order[lo + 1], &tab.order[lo],
+		(id - lo) * sizeof *tab.order);
+	tab.order[lo] = id;
+
+	uint64_t prev = lo > 0 ? tab.rank[tab.order[lo - 1]] : 0;
+	uint64_t next = lo < id ? tab.rank[tab.order[lo + 1]] : UINT64_MAX;
+	if (lo == 0 && id > 0 && next >= 2 * RANK_GAP) {
+		prev = next - 2 * RANK_GAP;
+	} else if (lo == id && id > 0 && prev <= UINT64_MAX - 2 * RANK_GAP) {
+		next = prev + 2 * RANK_GAP;
+	}
+	if (id == 0) {
+		tab.rank[id] = RANK_MID;
+	} else if (next - prev < 2) {
+		renumber(id + 1);
+	} else {
+		tab.rank[id] = prev + (next - prev) / 2;
+	}
+}
+
+// Return the id of `name`, adding it to the symbol table if it is new.
+int intern(const char *name)
+{
+	if (!tab.slots) {
+		rehash(SLOTS_INIT);
+	}
+	unsigned long i = hash(name) & (tab.nslots - 1);
+	for (; tab.slots[i] >= 0; i = (i + 1) & (tab.nslots - 1)) {
+		if (strcmp(tab.names[tab.slots[i]], name) == 0) {
+			return tab.slots[i];
+		}
+	}
+
+	if (tab.len == tab.cap) {
+		tab.cap = tab.cap ? tab.cap * 2 : SLOTS_INIT / 2;
+		tab.names = realloc(tab.names, tab.cap * sizeof *tab.names);
+		tab.rank = realloc(tab.rank, tab.cap * sizeof *tab.rank);
+		tab.order = realloc(tab.order, tab.cap * sizeof *tab.order);
+	}
+	int id = tab.len++;
+	tab.names[id] = malloc(strlen(name) + 1);
+	strcpy(tab.names[id], name);
+	insert_order(id);
+
+	if (2 * tab.len > tab.nslots) {
+		rehash(2 * tab.nslots);
+	} else {
+		tab.slots[i] = id;
+	}
+	return id;
+}
+
+// Return the name of the symbol `sym`.
+const char *sym_name(int sym) { return tab.names[sym]; }
+
+// Compare two symbols by the lexicographic order of their names.
+int sym_cmp(int s1, int s2)
+{
+	if (s1 == s2) {
+		return 0;
+	}
+	return tab.rank[s1] < tab.rank[s2] ? -1 : 1;
+}
+
+// Return the number of symbols, whose ids are less than it.
+int sym_count(void) { return tab.len; }
+
+// Release the symbol table.
+void free_syms(void)
+{
+	for (int id = 0; id < tab.len; ++id) {
+		free(tab.names[id]);
+	}
+	free(tab.names);
+	free(tab.rank);
+	free(tab.order);
+	free(tab.slots);
+	tab.names = NULL;
+	tab.rank = NULL;
+	tab.order = tab.slots = NULL;
+	tab.len = tab.cap = tab.nslots = 0;
+}
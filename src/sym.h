@@ -0,0 +1,26 @@
+#ifndef SYM_H
+#define SYM_H
+
+// Variable names are interned into a global symbol table. Each distinct name is
+// stored exactly once and is referred to by a small non-negative integer id, so
+// that copying or comparing a variable never touches its name.
+
+// Return the id of `name`, adding it to the symbol table if it is new.
+int intern(const char *name);
+
+// Return the name of the symbol `sym`.
+const char *sym_name(int sym);
+
+// Compare two symbols by the lexicographic order of their names.
+// Ids are assigned in order of appearance, so the order is kept in a separate
+// rank table maintained as symbols are interned, whose ranks are spaced apart
+// so that most symbols are ranked without renumbering the others.
+int sym_cmp(int s1, int s2);
+
+// Return the number of symbols, whose ids are less than it.
+int sym_count(void);
+
+// Release the symbol table.
+void free_syms(void);
+
+#endif /* ifndef SYM_H */
@@ -1,26 +1,26 @@
 #include "term.h"
-#include "util.h"
+#include "coeff.h"
+#include "mono.h"
+#include "out.h"
+#include "pool.h"
+#include "stats.h"
+#include "sym.h"
+#include "vec.h"
+#include <limits.h>
 #include <stdbool.h>
 #include <stdio.h>
 #include <stdlib.h>
-#include <string.h>
-#include <tgmath.h>
 
 // Forward declarations for static functions
 static int var_cmp(const TermNode *t1, const TermNode *t2);
 static void add_coeff(TermNode *dest, const TermNode *src);
-static void mul_coeff(TermNode *dest, const TermNode *src);
 static void div_coeff(TermNode *dest, const TermNode *src);
 
-static bool zero(TermNode *t);
+static bool zero(const TermNode *t);
 static void reduce0(TermNode **p);
 
 static TermNode *term_dup(const TermNode *t);
-static TermNode *var_dup(const TermNode *v);
 
-static void mul_var(TermNode **dest, TermNode *src);
-
-static void pow_num(TermNode **dest, TermNode *src);
 static void ipow_poly(TermNode **dest, long exp);
 
 static void free_term(TermNode *t);
@@ -28,24 +28,34 @@ static void print_var(const TermNode *v);
 
 TermNode *icoeff_term(long val)
 {
-	TermNode *term = malloc(sizeof *term);
+	TermNode *term = pool_alloc(term_pool);
+	count_alloc();
 	*term = (TermNode){ICOEFF_TERM, .hd.ival = val, .u.vars = NULL, NULL};
 	return term;
 }
 
 TermNode *rcoeff_term(double val)
 {
-	TermNode *term = malloc(sizeof *term);
+	TermNode *term = pool_alloc(term_pool);
+	count_alloc();
 	*term = (TermNode){RCOEFF_TERM, .hd.rval = val, .u.vars = NULL, NULL};
 	return term;
 }
 
-TermNode *var_term(char *name, long pow)
+// Allocate a coefficient term taking over the value of `c`.
+TermNode *coeff_term(const Coeff *c)
 {
-	TermNode *term = malloc(sizeof *term);
-	char *s = malloc(strlen(name) + 1);
-	strcpy(s, name);
-	*term = (TermNode){VAR_TERM, .hd.name = s, .u.pow = pow, NULL};
+	TermNode *term = pool_alloc(term_pool);
+	count_alloc();
+	*term = (TermNode){c->type, .hd = c->hd, .u.vars = NULL, NULL};
+	return term;
+}
+
+TermNode *var_term(int sym, long pow)
+{
+	TermNode *term = pool_alloc(term_pool);
+	count_alloc();
+	*term = (TermNode){VAR_TERM, .hd.sym = sym, .u.pow = pow, NULL};
 	return term;
 }
 
@@ -53,190 +63,85 @@ TermNode *var_term(char *name, long pow)
 // `t1` and `t2` must be `VARM_TERM`s or `NULL`s.
 static int var_cmp(const TermNode *t1, const TermNode *t2)
 {
-	if (!t1 && !t2) {
-		return 0;
-	} else if (t1 && !t2) {
-		return 1;
-	} else if (!t1 && t2) {
-		return -1;
-	}
-	// `t1->type` and `t2->type` must both be `VAR_TERM`s.
-	int cmp = strcmp(t1->hd.name, t2->hd.name);
-	if (cmp) {
-		// Prioritize reverse-lexicographically, e.g., 'x' > 'y' > 'z'.
-		return -cmp;
-	}
-	// `t1` and `t2` start with a same variable term.
-	cmp = (t1->u.pow > t2->u.pow) - (t1->u.pow < t2->u.pow);
-	if (cmp) {
-		return cmp;
+	for (; t1 && t2; t1 = t1->next, t2 = t2->next) {
+		// `t1->type` and `t2->type` must both be `VAR_TERM`s.
+		int cmp = sym_cmp(t1->hd.sym, t2->hd.sym);
+		if (cmp) {
+			// Prioritize reverse-lexicographically, e.g.,
+			// 'x' > 'y' > 'z'.
+			return -cmp;
+		}
+		// `t1` and `t2` start with a same variable term.
+		cmp = (t1->u.pow > t2->u.pow) - (t1->u.pow < t2->u.pow);
+		if (cmp) {
+			return cmp;
+		}
 	}
-	return var_cmp(t1->next, t2->next);
+	return !!t1 - !!t2;
 }
 
 int coeff_cmp(const TermNode *p1, const TermNode *p2)
 {
-	switch (p1->type) {
-	case ICOEFF_TERM:
-		switch (p2->type) {
-		case ICOEFF_TERM:
-			return ncmp(p1->hd.ival, p2->hd.ival);
-		case RCOEFF_TERM:
-			return ncmp(p1->hd.ival, p2->hd.rval);
-		default:
-			fprintf(stderr, "unexpected node type %d\n", p2->type);
-			abort();
+	Coeff c1 = coeff_of(p1), c2 = coeff_of(p2);
+	return cmp_coeff(&c1, &c2);
+}
+
+int poly_cmp(const TermNode *p1, const TermNode *p2)
+{
+	for (; p1 && p2; p1 = p1->next, p2 = p2->next) {
+		int cmp = var_cmp(p1->u.vars, p2->u.vars);
+		if (cmp) {
+			return cmp;
 		}
-	case RCOEFF_TERM:
-		switch (p2->type) {
-		case ICOEFF_TERM:
-			return ncmp(p1->hd.rval, p2->hd.ival);
-		case RCOEFF_TERM:
-			return ncmp(p1->hd.rval, p2->hd.rval);
-		default:
-			fprintf(stderr, "unexpected node type %d\n", p2->type);
-			abort();
+		// `p1` and `p2` have the same highest-order term ignoring
+		// coefficients.
+		cmp = coeff_cmp(p1, p2);
+		if (cmp) {
+			return cmp;
 		}
-	default:
-		fprintf(stderr, "unexpected node type %d\n", p1->type);
-		abort();
 	}
+	return !!p1 - !!p2;
 }
 
-int poly_cmp(const TermNode *p1, const TermNode *p2)
+static unsigned long mix(unsigned long h, unsigned long v)
 {
-	if (!p1 && !p2) {
-		return 0;
-	} else if (p1 && !p2) {
-		return 1;
-	} else if (!p1 && p2) {
-		return -1;
-	}
-	int cmp = var_cmp(p1->u.vars, p2->u.vars);
-	if (cmp) {
-		return cmp;
-	}
-	// `p1` and `p2` have the same highest-order term ignoring coefficients.
-	cmp = coeff_cmp(p1, p2);
-	if (cmp) {
-		return cmp;
-	}
-	return poly_cmp(p1->next, p2->next);
+	return (h ^ v) * 1099511628211UL;
 }
 
-static void add_coeff(TermNode *dest, const TermNode *src)
+unsigned long poly_hash(const TermNode *p)
 {
-	switch (dest->type) {
-	case ICOEFF_TERM:
-		switch (src->type) {
-		case ICOEFF_TERM:
-			dest->hd.ival += src->hd.ival;
-			return;
-		case RCOEFF_TERM:
-			dest->type = RCOEFF_TERM;
-			dest->hd.rval = dest->hd.ival + src->hd.rval;
-			return;
-		default:
-			fprintf(stderr, "unexpected node type %d\n", src->type);
-			abort();
-		}
-	case RCOEFF_TERM:
-		switch (src->type) {
-		case ICOEFF_TERM:
-			dest->hd.rval += src->hd.ival;
-			return;
-		case RCOEFF_TERM:
-			dest->hd.rval += src->hd.rval;
-			return;
-		default:
-			fprintf(stderr, "unexpected node type %d\n", src->type);
-			abort();
+	unsigned long h = 14695981039346656037UL;
+	for (; p; p = p->next) {
+		for (const TermNode *v = p->u.vars; v; v = v->next) {
+			h = mix(mix(h, v->hd.sym), v->u.pow);
 		}
-	default:
-		fprintf(stderr, "unexpected node type %d\n", dest->type);
-		abort();
+		Coeff c = coeff_of(p);
+		h = mix(h, coeff_hash(&c));
 	}
+	return h;
 }
 
-static void mul_coeff(TermNode *dest, const TermNode *src)
+static void add_coeff(TermNode *dest, const TermNode *src)
 {
-	switch (dest->type) {
-	case ICOEFF_TERM:
-		switch (src->type) {
-		case ICOEFF_TERM:
-			dest->hd.ival *= src->hd.ival;
-			return;
-		case RCOEFF_TERM:
-			dest->type = RCOEFF_TERM;
-			dest->hd.rval = dest->hd.ival * src->hd.rval;
-			return;
-		default:
-			fprintf(stderr, "unexpected node type %d\n", src->type);
-			abort();
-		}
-	case RCOEFF_TERM:
-		switch (src->type) {
-		case ICOEFF_TERM:
-			dest->hd.rval *= src->hd.ival;
-			return;
-		case RCOEFF_TERM:
-			dest->hd.rval *= src->hd.rval;
-			return;
-		default:
-			fprintf(stderr, "unexpected node type %d\n", src->type);
-			abort();
-		}
-	default:
-		fprintf(stderr, "unexpected node type %d\n", dest->type);
-		abort();
-	}
+	Coeff c = coeff_of(dest), d = coeff_of(src);
+	coeff_add(&c, &d);
+	dest->type = c.type;
+	dest->hd = c.hd;
 }
 
 // `src` should be guaranteed to contain a non-zero number.
 static void div_coeff(TermNode *dest, const TermNode *src)
 {
-	switch (dest->type) {
-	case ICOEFF_TERM:
-		switch (src->type) {
-		case ICOEFF_TERM:
-			if (dest->hd.ival % src->hd.ival) {
-				dest->type = RCOEFF_TERM;
-				dest->hd.rval =
-				    dest->hd.ival / (double)src->hd.ival;
-			} else {
-				dest->hd.ival /= src->hd.ival;
-			}
-			return;
-		case RCOEFF_TERM:
-			dest->type = RCOEFF_TERM;
-			dest->hd.rval = dest->hd.ival / src->hd.rval;
-			return;
-		default:
-			fprintf(stderr, "unexpected node type %d\n", src->type);
-			abort();
-		}
-	case RCOEFF_TERM:
-		switch (src->type) {
-		case ICOEFF_TERM:
-			dest->hd.rval /= src->hd.ival;
-			return;
-		case RCOEFF_TERM:
-			dest->hd.rval /= src->hd.rval;
-			return;
-		default:
-			fprintf(stderr, "unexpected node type %d\n", src->type);
-			abort();
-		}
-	default:
-		fprintf(stderr, "unexpected node type %d\n", dest->type);
-		abort();
-	}
+	Coeff c = coeff_of(dest), d = coeff_of(src);
+	coeff_div(&c, &d);
+	dest->type = c.type;
+	dest->hd = c.hd;
 }
 
-static bool zero(TermNode *t)
+static bool zero(const TermNode *t)
 {
-	return (t->type == ICOEFF_TERM && t->hd.ival == 0) ||
-	       (t->type == RCOEFF_TERM && t->hd.rval == 0);
+	Coeff c = coeff_of(t);
+	return coeff_zero(&c);
 }
 
 // Remove zero-terms from `*p`. If `*p` is equivalent to 0, it reduces to a
@@ -263,9 +168,24 @@ static void reduce0(TermNode **p)
 // This is essentially merging two linked lists.
 // Argument passed to `src` must not be used after `add_poly` is called.
 // `TermNode`s composing the polynomial represented by `src` are either rewired
-// to `dest` accordingly or completely released from memory.
+// to `dest` accordingly or completely released from memory. Terms cancelling
+// out are released while merging, so the result needs no further reduction.
 bool add_poly(TermNode **dest, TermNode *src)
 {
+	// The zero polynomial is a single zero term, which should not be
+	// merged with other terms.
+	if (zero(src) && !src->next) {
+		free_poly(src);
+		return true;
+	}
+	if (zero(*dest) && !(*dest)->next) {
+		free_poly(*dest);
+		*dest = src;
+		return true;
+	}
+	own_poly(dest);
+	own_poly(&src);
+
 	// `*p` is the head pointer initially; `next` of a `TermNode`, if
 	// traversed.
 	// The double-pointer allows a uniform handling of both the head
@@ -288,14 +208,24 @@ bool add_poly(TermNode **dest, TermNode *src)
 			src = tmp;
 		} else {
 			// Increase the coefficient of `**p` and release `src`.
+			// Release `**p` as well if they cancel out.
 			add_coeff(*p, src);
-			p = &(*p)->next;
+			if (zero(*p)) {
+				TermNode *del = *p;
+				*p = del->next;
+				free_term(del);
+			} else {
+				p = &(*p)->next;
+			}
 			TermNode *tmp = src;
 			src = src->next;
 			free_term(tmp);
 		}
 	}
-	reduce0(dest);
+	if (!*dest) {
+		// Every term has been cancelled out.
+		*dest = icoeff_term(0);
+	}
 	return true;
 }
 
@@ -304,40 +234,32 @@ bool add_poly(TermNode **dest, TermNode *src)
 bool sub_poly(TermNode **dest, TermNode *src)
 {
 	bool success = true;
-	success = success && neg_poly(src);
+	success = success && neg_poly(&src);
 	success = success && add_poly(dest, src);
 	return success;
 }
 
 static TermNode *term_dup(const TermNode *t)
 {
+	Coeff c;
 	switch (t->type) {
 	case ICOEFF_TERM:
 		return icoeff_term(t->hd.ival);
 	case RCOEFF_TERM:
 		return rcoeff_term(t->hd.rval);
+	case BCOEFF_TERM:
+	case QCOEFF_TERM:
+		c = coeff_of(t);
+		c = coeff_dup(&c);
+		return coeff_term(&c);
 	case VAR_TERM:
-		return var_term(t->hd.name, t->u.pow);
+		return var_term(t->hd.sym, t->u.pow);
 	default:
 		fprintf(stderr, "unexpected node type %d\n", t->type);
 		abort();
 	}
 }
 
-static TermNode *var_dup(const TermNode *v)
-{
-	TermNode *hd, **dup;
-	dup = NULL;
-	for (hd = term_dup(v); v; v = v->next, dup = &(*dup)->next) {
-		if (!dup) {
-			dup = &hd;
-		} else {
-			*dup = term_dup(v);
-		}
-	}
-	return hd;
-}
-
 // Duplicate `p`.
 TermNode *poly_dup(const TermNode *p)
 {
@@ -358,72 +280,49 @@ TermNode *poly_dup(const TermNode *p)
 	return hd;
 }
 
-// Multiply `src` to `dest`--both should point directly to `VAR_TERM`s.
-// This is analagous to `add_poly` function, as it is merging two sorted
-// `VAR_TERM` lists.
-static void mul_var(TermNode **dest, TermNode *src)
+// Return a new reference to `p`, which is shared until all but one of its
+// references are released.
+TermNode *share_poly(TermNode *p)
 {
-	TermNode **p = dest;
-	while (src) {
-		if (!*p) {
-			*p = src;
-			return;
-		}
-		// Again, prioritize reverse-lexicographically.
-		int cmp = -strcmp((*p)->hd.name, src->hd.name);
-		if (cmp > 0) {
-			p = &(*p)->next;
-		} else if (cmp < 0) {
-			TermNode *tmp = src->next;
-			src->next = *p;
-			*p = src;
-			src = tmp;
-		} else {
-			(*p)->u.pow += src->u.pow;
-			p = &(*p)->next;
-			TermNode *tmp = src;
-			src = src->next;
-			// No dedicated function to free a single `VAR_TERM`.
-			free(tmp->hd.name);
-			free(tmp);
-		}
+	++p->refs;
+	return p;
+}
+
+// Make `*p` safe to modify, replacing it with a copy if it is shared.
+void own_poly(TermNode **p)
+{
+	if ((*p)->refs) {
+		--(*p)->refs;
+		*p = poly_dup(*p);
 	}
 }
 
 // Multiply `src` to `dest`.
-// Uses distributive law to multiply.
+// Both operands are converted to `PolyVec`s over a common monomial layout, and
+// the product is built in sorted order by `vec_mul`, with a row per term of
+// the shorter operand.
 // Argument passed to `src` must not be used after `mul_poly` is called.
 bool mul_poly(TermNode **dest, TermNode *src)
 {
-	// `dup` points to the head pointer initially, and then points to the
-	// copy of `*dest` afterwords (only if there are more than one term
-	// in `src` to apply distributive law).
-	// `dup` is there only to keep a pointer later to be assigned to `p`.
-	TermNode **dup, **p;
-	for (dup = p = dest; src; p = dup) {
-		if (src->next) {
-			TermNode *tmp = poly_dup(*dup);
-			// Get a fresh slot for a head pointer container.
-			dup = malloc(sizeof *dup);
-			*dup = tmp;
-		}
-		TermNode *svars = src->u.vars;
-		// Multiply a term `*src` to each of the terms in `*p`.
-		for (TermNode **i = p; *i; i = &(*i)->next) {
-			mul_coeff(*i, src);
-			if (svars) {
-				mul_var(&(*i)->u.vars, var_dup(svars));
-			}
-		}
-		if (p != dest) {
-			add_poly(dest, *p);
-			free(p); // Allocated by `dup`.
-		}
-		TermNode *tmp = src;
-		src = src->next;
-		free_term(tmp);
-	}
-	reduce0(dest);
+	MonoLayout *lay =
+	    new_layout(*dest, src, max_pow(*dest) + max_pow(src));
+	PolyVec a, b, prod;
+	vec_from_poly(&a, lay, *dest);
+	vec_from_poly(&b, lay, src);
+	if (a.len < b.len) {
+		PolyVec tmp = a;
+		a = b;
+		b = tmp;
+	}
+	vec_mul(&prod, &a, &b);
+
+	free_poly(*dest);
+	free_poly(src);
+	*dest = vec_to_poly(&prod);
+	free_vec(&prod);
+	free_vec(&b);
+	free_vec(&a);
+	free_layout(lay);
 	return true;
 }
 
@@ -433,80 +332,39 @@ bool div_poly(TermNode **dest, TermNode *src)
 {
 	bool success = true;
 	if (src->u.vars) {
-		printf("Division by a polynomial is not supported.\n");
+		out_str("Division by a polynomial is not supported.\n");
 		success = false;
 		goto src_cleanup;
 	}
 	if (zero(src)) {
-		printf("Division by ZERO.\n");
+		out_str("Division by ZERO.\n");
 		success = false;
 		goto src_cleanup;
 	}
-	for (; *dest; dest = &(*dest)->next) {
-		div_coeff(*dest, src);
+	own_poly(dest);
+	TermNode **p;
+	for (p = dest; *p; p = &(*p)->next) {
+		div_coeff(*p, src);
 	}
+	// Real coefficients might have underflowed to zero.
+	reduce0(dest);
 src_cleanup:
 	free_poly(src);
 	return success;
 }
 
-// Both `*dest` and `src` should be number terms.
-static void pow_num(TermNode **dest, TermNode *src)
-{
-	switch ((*dest)->type) {
-	case ICOEFF_TERM:
-		switch (src->type) {
-		case ICOEFF_TERM:
-			if (src->hd.ival < 0) {
-				(*dest)->type = RCOEFF_TERM;
-				(*dest)->hd.rval =
-				    pow((*dest)->hd.ival, src->hd.ival);
-			} else {
-				(*dest)->hd.ival =
-				    pow((*dest)->hd.ival, src->hd.ival);
-			}
-			return;
-		case RCOEFF_TERM:
-			(*dest)->type = RCOEFF_TERM;
-			(*dest)->hd.rval = pow((*dest)->hd.ival, src->hd.rval);
-			return;
-		default:
-			fprintf(stderr, "unexpected node type %d\n", src->type);
-			abort();
-		}
-	case RCOEFF_TERM:
-		switch (src->type) {
-		case ICOEFF_TERM:
-			(*dest)->hd.rval = pow((*dest)->hd.rval, src->hd.ival);
-			return;
-		case RCOEFF_TERM:
-			(*dest)->hd.rval = pow((*dest)->hd.rval, src->hd.rval);
-			return;
-		default:
-			fprintf(stderr, "unexpected node type %d\n", src->type);
-			abort();
-		}
-	default:
-		fprintf(stderr, "unexpected node type %d\n", (*dest)->type);
-		abort();
-	}
-}
-
-// `exp` should be a positive integer.
+// Raise `*dest` to the power of `exp`, a positive integer.
 static void ipow_poly(TermNode **dest, long exp)
 {
-	if (exp < 2) {
-		return;
-	}
-	TermNode *dup;
-	if (exp % 2) {
-		dup = poly_dup(*dest);
-		ipow_poly(dest, exp - 1);
-	} else {
-		ipow_poly(dest, exp / 2);
-		dup = poly_dup(*dest);
-	}
-	mul_poly(dest, dup);
+	MonoLayout *lay = new_layout(*dest, NULL, max_pow(*dest) * exp);
+	PolyVec a, p;
+	vec_from_poly(&a, lay, *dest);
+	vec_pow(&p, &a, exp);
+	free_poly(*dest);
+	*dest = vec_to_poly(&p);
+	free_vec(&p);
+	free_vec(&a);
+	free_layout(lay);
 }
 
 // Exponentiate `src` to `dest`.
@@ -515,25 +373,35 @@ bool pow_poly(TermNode **dest, TermNode *src)
 {
 	bool success = true;
 	if (src->u.vars) {
-		printf("Exponentiation with a polynomial is not supported.\n");
+		out_str("Exponentiation with a polynomial is not "
+			"supported.\n");
 		success = false;
 		goto src_cleanup;
 	}
 	if (!(*dest)->u.vars) { // `*dest` is a number term.
-		pow_num(dest, src);
+		own_poly(dest);
+		Coeff c = coeff_of(*dest), e = coeff_of(src);
+		coeff_pow(&c, &e);
+		(*dest)->type = c.type;
+		(*dest)->hd = c.hd;
 		goto src_cleanup;
 	}
-	if (src->type == RCOEFF_TERM) {
-		printf("Exponentiation with a polynomial and a real number is "
-		       "not supported.\n");
+	if (src->type == RCOEFF_TERM || src->type == QCOEFF_TERM) {
+		out_str("Exponentiation with a polynomial and a real number is "
+			"not supported.\n");
 		success = false;
 		goto src_cleanup;
 	}
 
-	long exp = src->hd.ival;
-	if (exp < 0) {
-		printf("Exponentiation with a polynomial and a negative "
-		       "integer is not supported.\n");
+	Coeff e = coeff_of(src);
+	long exp = src->type == ICOEFF_TERM ? src->hd.ival : 0;
+	if (coeff_sgn(&e) < 0) {
+		out_str("Exponentiation with a polynomial and a negative "
+			"integer is not supported.\n");
+		success = false;
+	} else if (src->type == BCOEFF_TERM ||
+		   exp > LONG_MAX / max_pow(*dest)) {
+		out_str("Exponent is too large.\n");
 		success = false;
 	} else if (exp == 0) {
 		TermNode *tmp = *dest;
@@ -547,48 +415,48 @@ src_cleanup:
 	return success;
 }
 
-// Negate `dest`.
-bool neg_poly(TermNode *dest)
+// Negate `*dest`.
+bool neg_poly(TermNode **dest)
 {
-	for (; dest; dest = dest->next) {
-		switch (dest->type) {
-		case ICOEFF_TERM:
-			dest->hd.ival = -dest->hd.ival;
-			break;
-		case RCOEFF_TERM:
-			dest->hd.rval = -dest->hd.rval;
-			break;
-		default:
-			fprintf(stderr, "unexpected node type %d\n",
-				dest->type);
-			abort();
-		}
+	own_poly(dest);
+	for (TermNode *t = *dest; t; t = t->next) {
+		Coeff c = coeff_of(t);
+		coeff_neg(&c);
+		t->type = c.type;
+		t->hd = c.hd;
 	}
 	return true;
 }
 
 // Release a single `COEFF_TERM` and/or all linked `VAR_TERM`s.
-// Does not recursively release linked `COEFF_TERM` terms. For that purpose, use
+// Does not release linked `COEFF_TERM` terms. For that purpose, use
 // `free_poly`.
 static void free_term(TermNode *t)
 {
-	if (!t) {
-		return;
-	}
-	switch (t->type) {
-	case ICOEFF_TERM:
-	case RCOEFF_TERM:
-		free_term(t->u.vars);
-		break;
-	case VAR_TERM:
-		free(t->hd.name);
-		free_term(t->next);
-		break;
-	default:
-		fprintf(stderr, "unexpected node type %d\n", t->type);
-		abort();
+	while (t) {
+		TermNode *next;
+		Coeff c;
+		switch (t->type) {
+		case BCOEFF_TERM:
+		case QCOEFF_TERM:
+			c = coeff_of(t);
+			free_coeff(&c);
+			// fall through
+		case ICOEFF_TERM:
+		case RCOEFF_TERM:
+			next = t->u.vars;
+			break;
+		case VAR_TERM:
+			next = t->next;
+			break;
+		default:
+			fprintf(stderr, "unexpected node type %d\n", t->type);
+			abort();
+		}
+		count_free();
+		pool_free(term_pool, t);
+		t = next;
 	}
-	free(t);
 }
 
 static void print_var(const TermNode *v)
@@ -596,38 +464,142 @@ static void print_var(const TermNode *v)
 	for (; v; v = v->next) {
 		int p = v->u.pow;
 		if (p == 1) {
-			printf("%s ", v->hd.name);
+			out_str(sym_name(v->hd.sym));
+			out_char(' ');
 		} else {
-			printf("%s^%d ", v->hd.name, p);
+			out_str(sym_name(v->hd.sym));
+			out_char('^');
+			out_long(p);
+			out_char(' ');
 		}
 	}
 }
 
+// Print the single term `t`.
+static void print_term(const TermNode *t)
+{
+	if (t->type != ICOEFF_TERM || t->hd.ival != 1 || !t->u.vars) {
+		Coeff c = coeff_of(t);
+		print_coeff(&c);
+		out_char(' ');
+	}
+	print_var(t->u.vars);
+}
+
 // Print a polynomial pointed by `p`.
 void print_poly(const TermNode *p)
 {
 	while (p) {
-		if (p->type == ICOEFF_TERM) {
-			if (p->hd.ival != 1 || !p->u.vars) {
-				printf("%ld ", p->hd.ival);
-			}
-		} else {
-			printf("%lf ", p->hd.rval);
-		}
-		print_var(p->u.vars);
+		print_term(p);
 		p = p->next;
 		if (p) {
-			printf("+ ");
+			out_str("+ ");
+		}
+	}
+}
+
+// The terms of a product or a power being streamed from `vs`, or the result
+// `p` if it is built instead.
+struct PolyStream {
+	MonoLayout *lay;
+	PolyVec a, b;
+	VecStream *vs;
+	TermNode *p;
+};
+
+PolyStream *stream_mul(TermNode *p1, TermNode *p2)
+{
+	PolyStream *s = calloc(1, sizeof *s);
+	s->lay = new_layout(p1, p2, max_pow(p1) + max_pow(p2));
+	vec_from_poly(&s->a, s->lay, p1);
+	vec_from_poly(&s->b, s->lay, p2);
+	if (s->a.len < s->b.len) {
+		PolyVec tmp = s->a;
+		s->a = s->b;
+		s->b = tmp;
+	}
+	s->vs = vec_stream_mul(&s->a, &s->b);
+	free_poly(p1);
+	free_poly(p2);
+	return s;
+}
+
+PolyStream *stream_pow(TermNode *dest, TermNode *src)
+{
+	long exp = src->type == ICOEFF_TERM && !src->u.vars ? src->hd.ival : 0;
+	if (!dest->u.vars || exp < 1 || exp > LONG_MAX / max_pow(dest)) {
+		// Not a power to expand, or an exception.
+		if (!pow_poly(&dest, src)) {
+			return NULL;
+		}
+		PolyStream *s = calloc(1, sizeof *s);
+		s->p = dest;
+		return s;
+	}
+	PolyStream *s = calloc(1, sizeof *s);
+	s->lay = new_layout(dest, NULL, max_pow(dest) * exp);
+	vec_from_poly(&s->a, s->lay, dest);
+	s->vs = vec_stream_pow(&s->a, exp);
+	free_poly(dest);
+	free_poly(src);
+	if (!s->vs) {
+		out_str("Not enough memory to expand the power.\n");
+		free_vec(&s->a);
+		free_layout(s->lay);
+		free(s);
+		return NULL;
+	}
+	return s;
+}
+
+long print_stream(PolyStream *s)
+{
+	long n = 0;
+	if (s->p) {
+		print_poly(s->p);
+		for (const TermNode *t = s->p; t; t = t->next) {
+			++n;
 		}
+		free_poly(s->p);
+		free(s);
+		return n;
 	}
+
+	Coeff c;
+	const uint64_t *m;
+	while (vec_next(s->vs, &c, &m)) {
+		if (n++) {
+			out_str("+ ");
+		}
+		TermNode *t = coeff_term(&c);
+		t->u.vars = mono_unpack(s->lay, m);
+		print_term(t);
+		free_term(t);
+	}
+	if (!n) { // The zero polynomial
+		out_str("0 ");
+		n = 1;
+	}
+	free_stream(s->vs);
+	free_vec(&s->b);
+	free_vec(&s->a);
+	free_layout(s->lay);
+	free(s);
+	return n;
 }
 
-// Release a polynomial, i.e., `COEFF_TERM` typed `TermNode` linked together.
+// Release a polynomial, i.e., `COEFF_TERM` typed `TermNode` linked together,
+// or a reference to it if it is shared.
+// Terms are released front to back, so that long polynomials take no stack.
 void free_poly(TermNode *p)
 {
-	if (!p) {
+	if (p && p->refs) {
+		--p->refs;
 		return;
 	}
-	free_poly(p->next);
-	free_term(p);
+	while (p) {
+		TermNode *next = p->next;
+		free_term(p);
+		p = next;
+	}
 }
@@ -18,25 +18,59 @@
  *     | x | 1 | #-+-->| y | 2 | $ |
  *     +---+---+---+   +---+---+---+
  */
+/*
+ * A polynomial may be shared, e.g., by the environment and the expressions
+ * referring to it. `refs` of its first term counts the references besides the
+ * one of the owner, and a shared polynomial must not be modified. Operations
+ * below copy a shared operand only if they would modify it, and releasing a
+ * reference to a shared polynomial only decrements the count. The count is
+ * atomic, as statements evaluated concurrently share the environment.
+ */
 typedef struct TermNode {
-	enum { ICOEFF_TERM, RCOEFF_TERM, VAR_TERM } type;
-	union {
-		long ival;   // ICOEFF_TERM
-		double rval; // RCOEFF_TERM
-		char *name;  // VAR_TERM
+	enum TermType {
+		ICOEFF_TERM,
+		RCOEFF_TERM,
+		BCOEFF_TERM,
+		QCOEFF_TERM,
+		VAR_TERM
+	} type;
+	_Atomic int refs; // Only meaningful in the first term of a polynomial
+	union TermHd {
+		long ival;	    // ICOEFF_TERM
+		double rval;	    // RCOEFF_TERM
+		struct BigInt *big; // BCOEFF_TERM, not fitting in a `long`
+		struct Rat *rat;    // QCOEFF_TERM, not an integer
+		int sym;	    // VAR_TERM
 	} hd;
 	union {
-		struct TermNode *vars; // I/RCOEFF_TERM
+		struct TermNode *vars; // I/R/B/QCOEFF_TERM
 		long pow;	       // VAR_TERM
 	} u;
 	struct TermNode *next;
 } TermNode;
 
+// The coefficient of an `I/R/B/QCOEFF_TERM`, detached from its node.
+typedef struct Coeff {
+	enum TermType type;
+	union TermHd hd;
+} Coeff;
+
+// Return the coefficient of `t`, still owned by `t`.
+static inline Coeff coeff_of(const TermNode *t)
+{
+	return (Coeff){t->type, t->hd};
+}
+
+// `TermNode`s are allocated from and released to `term_pool`.
+
 TermNode *icoeff_term(long val);
 
 TermNode *rcoeff_term(double val);
 
-TermNode *var_term(char *name, long pow);
+TermNode *var_term(int sym, long pow);
+
+// Allocate a coefficient term taking over the value of `c`.
+TermNode *coeff_term(const Coeff *c);
 
 int coeff_cmp(const TermNode *p1, const TermNode *p2);
 
@@ -44,9 +78,19 @@ int coeff_cmp(const TermNode *p1, const TermNode *p2);
 // prioritize higher orders. Compare the next term in case of a tie.
 int poly_cmp(const TermNode *p1, const TermNode *p2);
 
+// Return a hash of `p`, equal for polynomials equal by `poly_cmp`.
+unsigned long poly_hash(const TermNode *p);
+
 // Duplicate `p`.
 TermNode *poly_dup(const TermNode *p);
 
+// Return a new reference to `p`, which is shared until all but one of its
+// references are released.
+TermNode *share_poly(TermNode *p);
+
+// Make `*p` safe to modify, replacing it with a copy if it is shared.
+void own_poly(TermNode **p);
+
 // Add `src` to `dest`.
 // Argument passed to `src` must not be used after `add_poly` is called.
 bool add_poly(TermNode **dest, TermNode *src);
@@ -67,13 +111,32 @@ bool div_poly(TermNode **dest, TermNode *src);
 // Argument passed to `src` must not be used after `pow_poly` is called.
 bool pow_poly(TermNode **dest, TermNode *src);
 
-// Negate `dest`.
-bool neg_poly(TermNode *dest);
+// Negate `*dest`.
+bool neg_poly(TermNode **dest);
 
 // Print a polynomial pointed by `p`.
 void print_poly(const TermNode *p);
 
-// Release a polynomial, i.e., `COEFF_TERM` typed `TermNode` linked together.
+// A product or a power whose terms are printed as they are produced, with only
+// its operands in memory.
+typedef struct PolyStream PolyStream;
+
+// Return a stream of the product of `p1` and `p2`.
+// Arguments must not be used after `stream_mul` is called.
+PolyStream *stream_mul(TermNode *p1, TermNode *p2);
+
+// Return a stream of `dest` to the power of `src`, or `NULL` after an
+// exception, as `pow_poly` would raise, or if there is not enough memory to
+// expand the power.
+// Arguments must not be used after `stream_pow` is called.
+PolyStream *stream_pow(TermNode *dest, TermNode *src);
+
+// Print the terms of `s` as `print_poly` would, and release it. Return the
+// number of terms printed.
+long print_stream(PolyStream *s);
+
+// Release a polynomial, i.e., `COEFF_TERM` typed `TermNode` linked together,
+// or a reference to it if it is shared.
 void free_poly(TermNode *p);
 
 #endif /* ifndef TERM_H */
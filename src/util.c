@@ -3,6 +3,8 @@
 #include <math.h>
 #define DBL_LONG_MAX_P1 ((LONG_MAX / 2 + 1) * 2.0)
 
+_Thread_local FILE *stmt_out, *stmt_err;
+
 int cmp_long(long x, long y) { return (x > y) - (x < y); }
 
 int cmp_double(double x, double y) { return (x > y) - (x < y); }
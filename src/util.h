@@ -1,6 +1,12 @@
 #ifndef UTIL_H
 #define UTIL_H
 
+#include <stdio.h>
+
+// The streams the output and the error messages of the statement being
+// evaluated are printed to.
+extern _Thread_local FILE *stmt_out, *stmt_err;
+
 #define ncmp(x, y)                                                             \
 	_Generic((x), long                                                     \
 		 : _Generic((y), long                                          \
@@ -0,0 +1,864 @@
+#include "vec.h"
+#include "coeff.h"
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Products of fewer pairs of terms are not worth splitting across threads.
+#define PAR_MIN_PAIRS (1 << 16)
+
+_Thread_local int vec_threads = 1;
+
+// Initialize `v` as an empty vector with room for `cap` terms.
+void vec_init(PolyVec *v, const MonoLayout *lay, size_t cap)
+{
+	*v = (PolyVec){0, cap, NULL, NULL, lay};
+	if (cap) {
+		v->coeffs = malloc(cap * sizeof *v->coeffs);
+		v->monos = malloc(cap * lay->nwords * sizeof *v->monos);
+	}
+}
+
+// Initialize `v` with the terms of `p`. `lay` must cover every variable and
+// exponent of `p`.
+void vec_from_poly(PolyVec *v, const MonoLayout *lay, const TermNode *p)
+{
+	size_t n = 0;
+	for (const TermNode *t = p; t; t = t->next) {
+		++n;
+	}
+	vec_init(v, lay, n);
+	int w = lay->nwords;
+	for (; p; p = p->next) {
+		Coeff c = coeff_of(p);
+		if (coeff_zero(&c)) {
+			continue;
+		}
+		v->coeffs[v->len] = coeff_dup(&c);
+		mono_pack(lay, p->u.vars, &v->monos[v->len * w]);
+		++v->len;
+	}
+}
+
+// Return a polynomial with the terms of `v`, whose coefficients are moved to
+// the polynomial, leaving `v` empty.
+TermNode *vec_to_poly(PolyVec *v)
+{
+	if (!v->len) {
+		return icoeff_term(0);
+	}
+	int w = v->lay->nwords;
+	TermNode *hd, **p = &hd;
+	for (size_t i = 0; i < v->len; ++i) {
+		*p = coeff_term(&v->coeffs[i]);
+		(*p)->u.vars = mono_unpack(v->lay, &v->monos[i * w]);
+		p = &(*p)->next;
+	}
+	v->len = 0;
+	return hd;
+}
+
+// Grow `v` to hold at least `cap` terms.
+static void reserve(PolyVec *v, size_t cap)
+{
+	if (cap <= v->cap) {
+		return;
+	}
+	if (cap < 2 * v->cap) {
+		cap = 2 * v->cap;
+	}
+	v->coeffs = realloc(v->coeffs, cap * sizeof *v->coeffs);
+	v->monos = realloc(v->monos, cap * v->lay->nwords * sizeof *v->monos);
+	v->cap = cap;
+}
+
+// Append a term to `v`, taking over the value of `c`. The term must precede
+// every term already in `v`.
+void vec_push(PolyVec *v, const Coeff *c, const uint64_t *m)
+{
+	reserve(v, v->len + 1);
+	int w = v->lay->nwords;
+	v->coeffs[v->len] = *c;
+	memcpy(&v->monos[v->len * w], m, w * sizeof *m);
+	++v->len;
+}
+
+// Store the sum of `a` and `b` to `dest`, which must not alias either.
+// This is essentially merging two sorted arrays.
+void vec_add(PolyVec *dest, const PolyVec *a, const PolyVec *b)
+{
+	int w = a->lay->nwords;
+	vec_init(dest, a->lay, a->len + b->len);
+	size_t i = 0, j = 0, k = 0;
+	while (i < a->len && j < b->len) {
+		const uint64_t *am = &a->monos[i * w];
+		const uint64_t *bm = &b->monos[j * w];
+		int cmp = mono_cmp(am, bm, w);
+		if (cmp > 0) {
+			dest->coeffs[k] = coeff_dup(&a->coeffs[i++]);
+			memcpy(&dest->monos[k++ * w], am, w * sizeof *am);
+		} else if (cmp < 0) {
+			dest->coeffs[k] = coeff_dup(&b->coeffs[j++]);
+			memcpy(&dest->monos[k++ * w], bm, w * sizeof *bm);
+		} else {
+			Coeff c = coeff_dup(&a->coeffs[i++]);
+			coeff_add(&c, &b->coeffs[j++]);
+			if (coeff_zero(&c)) {
+				free_coeff(&c);
+			} else {
+				dest->coeffs[k] = c;
+				memcpy(&dest->monos[k++ * w], am,
+				       w * sizeof *am);
+			}
+		}
+	}
+	// At most one of the arrays has remaining terms.
+	for (; i < a->len; ++i, ++k) {
+		dest->coeffs[k] = coeff_dup(&a->coeffs[i]);
+		memcpy(&dest->monos[k * w], &a->monos[i * w],
+		       w * sizeof *a->monos);
+	}
+	for (; j < b->len; ++j, ++k) {
+		dest->coeffs[k] = coeff_dup(&b->coeffs[j]);
+		memcpy(&dest->monos[k * w], &b->monos[j * w],
+		       w * sizeof *b->monos);
+	}
+	dest->len = k;
+}
+
+// Store the product of `a` and a single term to `dest`, which must not alias
+// `a`. Multiplying by a monomial preserves the order of the terms.
+void vec_mul_term(PolyVec *dest, const PolyVec *a, const Coeff *c,
+		  const uint64_t *m)
+{
+	int w = a->lay->nwords;
+	vec_init(dest, a->lay, a->len);
+	size_t k = 0;
+	for (size_t i = 0; i < a->len; ++i) {
+		Coeff p = coeff_dup(&a->coeffs[i]);
+		coeff_mul(&p, c);
+		if (coeff_zero(&p)) {
+			free_coeff(&p);
+			continue;
+		}
+		dest->coeffs[k] = p;
+		mono_mul(&dest->monos[k * w], &a->monos[i * w], m, w);
+		++k;
+	}
+	dest->len = k;
+}
+
+// Restore the heap order of `heap`, a max-heap of `n` row indices keyed by
+// `monos[row * w]`, after its top has been replaced.
+static void sift_down(size_t *heap, size_t n, const uint64_t *monos, int w)
+{
+	size_t i = 0, top = heap[0];
+	for (;;) {
+		size_t c = 2 * i + 1;
+		if (c >= n) {
+			break;
+		}
+		if (c + 1 < n && mono_cmp(&monos[heap[c + 1] * w],
+					  &monos[heap[c] * w], w) > 0) {
+			++c;
+		}
+		if (mono_cmp(&monos[heap[c] * w], &monos[top * w], w) <= 0) {
+			break;
+		}
+		heap[i] = heap[c];
+		i = c;
+	}
+	heap[i] = top;
+}
+
+// Restore the heap order of `heap` after a row has been appended at `n - 1`.
+static void sift_up(size_t *heap, size_t n, const uint64_t *monos, int w)
+{
+	size_t i = n - 1, last = heap[i];
+	while (i) {
+		size_t p = (i - 1) / 2;
+		if (mono_cmp(&monos[heap[p] * w], &monos[last * w], w) >= 0) {
+			break;
+		}
+		heap[i] = heap[p];
+		i = p;
+	}
+	heap[i] = last;
+}
+
+// The state of Johnson's algorithm multiplying `a` and `b`: the product is the
+// merge of the rows `a * b[j]`, each of which is already sorted. A heap holds
+// the next term of every row, so the terms of the product are produced in
+// sorted order and equal monomials come out consecutively, to be summed right
+// away.
+typedef struct Rows {
+	const PolyVec *a, *b;
+	// `pos[j]` is the index of the next term of `a` in row `j`, and
+	// `monos[j * w]` is the monomial of that term times `b[j]`.
+	size_t *heap, *pos, n;
+	uint64_t *monos;
+	uint64_t *top; // Monomial of the term produced last
+} Rows;
+
+static void rows_init(Rows *r, const PolyVec *a, const PolyVec *b)
+{
+	int w = a->lay->nwords;
+	*r = (Rows){a, b, malloc(b->len * sizeof *r->heap),
+		    malloc(b->len * sizeof *r->pos), 0,
+		    malloc((b->len + 1) * w * sizeof *r->monos), NULL};
+	r->top = &r->monos[b->len * w];
+	for (size_t j = 0; a->len && j < b->len; ++j) {
+		r->pos[j] = 0;
+		mono_mul(&r->monos[j * w], a->monos, &b->monos[j * w], w);
+		r->heap[r->n++] = j;
+		sift_up(r->heap, r->n, r->monos, w);
+	}
+}
+
+// Store the coefficient of the next term of the product to `*c` and its
+// monomial to `r->top`. Return false if there are no terms left.
+static bool rows_next(Rows *r, Coeff *c)
+{
+	const PolyVec *a = r->a, *b = r->b;
+	int w = a->lay->nwords;
+	size_t *heap = r->heap, *pos = r->pos;
+	while (r->n) {
+		memcpy(r->top, &r->monos[heap[0] * w], w * sizeof *r->top);
+		Coeff sum = {ICOEFF_TERM, .hd.ival = 0};
+		do {
+			size_t j = heap[0];
+			coeff_addmul(&sum, &a->coeffs[pos[j]], &b->coeffs[j]);
+			if (++pos[j] < a->len) {
+				mono_mul(&r->monos[j * w],
+					 &a->monos[pos[j] * w],
+					 &b->monos[j * w], w);
+			} else {
+				heap[0] = heap[--r->n];
+			}
+			if (r->n) {
+				sift_down(heap, r->n, r->monos, w);
+			}
+		} while (r->n && !mono_cmp(&r->monos[heap[0] * w], r->top, w));
+		if (!coeff_zero(&sum)) {
+			*c = sum;
+			return true;
+		}
+		free_coeff(&sum);
+	}
+	return false;
+}
+
+static void free_rows(Rows *r)
+{
+	free(r->monos);
+	free(r->pos);
+	free(r->heap);
+}
+
+// Store the product of `a` and `b` to `dest`, which must not alias either.
+static void mul_rows(PolyVec *dest, const PolyVec *a, const PolyVec *b)
+{
+	vec_init(dest, a->lay, a->len + b->len);
+	if (!a->len || !b->len) {
+		return;
+	}
+	if (b->len == 1) {
+		free_vec(dest);
+		vec_mul_term(dest, a, &b->coeffs[0], b->monos);
+		return;
+	}
+	Rows r;
+	rows_init(&r, a, b);
+	Coeff c;
+	while (rows_next(&r, &c)) {
+		vec_push(dest, &c, r.top);
+	}
+	free_rows(&r);
+}
+
+// A product of `a` and a block of rows `b`, or a sum of `a` and `b`, to be
+// stored to `dest` by a worker thread.
+typedef struct Job {
+	PolyVec *dest;
+	PolyVec *a, *b;
+} Job;
+
+static void *mul_job(void *arg)
+{
+	Job *job = arg;
+	mul_rows(job->dest, job->a, job->b);
+	return NULL;
+}
+
+static void *add_job(void *arg)
+{
+	Job *job = arg;
+	vec_add(job->dest, job->a, job->b);
+	free_vec(job->a);
+	free_vec(job->b);
+	return NULL;
+}
+
+// Run `fn` on each of the `n` jobs, all but the first on threads of their own.
+// A job whose thread cannot be created is run on the calling thread instead.
+static void run_jobs(void *(*fn)(void *), Job *jobs, int n)
+{
+	pthread_t *tids = malloc(n * sizeof *tids);
+	bool *started = malloc(n * sizeof *started);
+	for (int i = 1; i < n; ++i) {
+		started[i] = !pthread_create(&tids[i], NULL, fn, &jobs[i]);
+	}
+	fn(&jobs[0]);
+	for (int i = 1; i < n; ++i) {
+		if (started[i]) {
+			pthread_join(tids[i], NULL);
+		} else {
+			fn(&jobs[i]);
+		}
+	}
+	free(started);
+	free(tids);
+}
+
+static bool exact(const PolyVec *v)
+{
+	for (size_t i = 0; i < v->len; ++i) {
+		if (v->coeffs[i].type == RCOEFF_TERM) {
+			return false;
+		}
+	}
+	return true;
+}
+
+// Store the product of `a` and `b` to `dest`, which must not alias either.
+// Large products are split into blocks of rows, one per thread, whose partial
+// products are then summed pairwise in parallel. Real coefficients would be
+// summed in a different order, and so are always multiplied serially to keep
+// the result identical.
+void vec_mul(PolyVec *dest, const PolyVec *a, const PolyVec *b)
+{
+	int n = vec_threads;
+	if ((size_t)n > b->len) {
+		n = b->len;
+	}
+	if (n < 2 || a->len * b->len < PAR_MIN_PAIRS || !exact(a) ||
+	    !exact(b)) {
+		mul_rows(dest, a, b);
+		return;
+	}
+
+	int w = b->lay->nwords;
+	PolyVec *parts = malloc(2 * n * sizeof *parts);
+	PolyVec *rows = &parts[n];
+	Job *jobs = malloc(n * sizeof *jobs);
+	for (int i = 0; i < n; ++i) {
+		size_t lo = b->len * i / n, hi = b->len * (i + 1) / n;
+		rows[i] = (PolyVec){hi - lo, 0, &b->coeffs[lo],
+				    &b->monos[lo * w], b->lay};
+		jobs[i] = (Job){&parts[i], (PolyVec *)a, &rows[i]};
+	}
+	run_jobs(mul_job, jobs, n);
+
+	// Each round sums pairs of partial products into the first half.
+	while (n > 1) {
+		int half = n / 2;
+		PolyVec *sums = malloc(half * sizeof *sums);
+		for (int i = 0; i < half; ++i) {
+			jobs[i] = (Job){&sums[i], &parts[2 * i],
+					&parts[2 * i + 1]};
+		}
+		run_jobs(add_job, jobs, half);
+		for (int i = 0; i < half; ++i) {
+			parts[i] = sums[i];
+		}
+		if (n % 2) {
+			parts[half] = parts[n - 1];
+		}
+		n = (n + 1) / 2;
+		free(sums);
+	}
+	*dest = parts[0];
+	free(jobs);
+	free(parts);
+}
+
+// State of a multinomial expansion of `(t_0 + ... + t_{r-1} + c)^k`, where
+// every `t_i` is a power of a distinct variable and `c` is an optional
+// constant term. Distinct tuples of exponents of the `t_i` then give distinct
+// monomials, and the tuples are walked depth first, one term at a time.
+// Each exponent runs downwards, so that the terms come out in the order of
+// `var_cmp`, and the multinomial coefficient is built up from the binomials
+// `C(rem, e)`, each updated from the previous one.
+typedef struct Multinom {
+	const PolyVec *a;
+	int r;
+	bool has_const, done;
+	Coeff *pw; // `pw[i * (k + 1) + e]` is the coefficient of `t_i^e`.
+	long k;
+	// `e[i]` is the exponent of `t_i` out of the `rem[i]` left for `t_i`
+	// onwards, and `binom[i]` is `C(rem[i], e[i])`. `coef[i]` and
+	// `monos[i * w]` are the product of the powers of `t_0` to `t_{i-1}`.
+	long *e, *rem;
+	Coeff *binom, *coef;
+	uint64_t *monos;
+	uint64_t *top; // Monomial of the term produced last
+} Multinom;
+
+// Fix the exponent of `t_i` to `e[i]`.
+static void fix_exp(Multinom *mn, int i)
+{
+	const PolyVec *a = mn->a;
+	int w = a->lay->nwords;
+	uint64_t *next = &mn->monos[(i + 1) * w];
+	free_coeff(&mn->coef[i + 1]);
+	mn->coef[i + 1] = coeff_dup(&mn->coef[i]);
+	coeff_mul(&mn->coef[i + 1], &mn->binom[i]);
+	coeff_mul(&mn->coef[i + 1], &mn->pw[i * (mn->k + 1) + mn->e[i]]);
+	mono_scale(next, &a->monos[i * w], mn->e[i], w);
+	mono_mul(next, next, &mn->monos[i * w], w);
+	mn->rem[i + 1] = mn->rem[i] - mn->e[i];
+}
+
+// Fix the exponents of `t_i` onwards to their first values.
+static void first_exps(Multinom *mn, int i)
+{
+	for (; i < mn->r; ++i) {
+		mn->e[i] = mn->rem[i];
+		free_coeff(&mn->binom[i]);
+		mn->binom[i] = (Coeff){ICOEFF_TERM, .hd.ival = 1};
+		fix_exp(mn, i);
+	}
+}
+
+// Decrement the exponent of `t_i`, or return false if it is the last one.
+static bool next_exp(Multinom *mn, int i)
+{
+	// The last variable takes all of the remaining exponent unless there
+	// is a constant term to take the rest.
+	long rem = mn->rem[i], e = mn->e[i];
+	long lo = i == mn->r - 1 && !mn->has_const ? rem : 0;
+	if (e == lo) {
+		return false;
+	}
+	// C(rem, e - 1) = C(rem, e) * e / (rem - e + 1)
+	Coeff f = {ICOEFF_TERM, .hd.ival = e};
+	coeff_mul(&mn->binom[i], &f);
+	f.hd.ival = rem - e + 1;
+	coeff_div(&mn->binom[i], &f);
+	--mn->e[i];
+	fix_exp(mn, i);
+	return true;
+}
+
+// Initialize `mn` to expand `a^k`, where `a` is not empty. Return false if
+// there is not enough memory, as the powers of the coefficients of `a` are
+// tabulated up to `k`.
+static bool multinom_init(Multinom *mn, const PolyVec *a, long k)
+{
+	int w = a->lay->nwords;
+	*mn = (Multinom){.a = a, .r = a->len, .k = k};
+	if (mono_var(a->lay, &a->monos[(a->len - 1) * w]) == -1) {
+		--mn->r;
+		mn->has_const = true;
+	}
+	int r = mn->r;
+	if ((size_t)k >= SIZE_MAX / sizeof *mn->pw / a->len) {
+		return false;
+	}
+	mn->pw = malloc(a->len * (k + 1) * sizeof *mn->pw);
+	mn->e = malloc((r + 1) * sizeof *mn->e);
+	mn->rem = malloc((r + 1) * sizeof *mn->rem);
+	mn->binom = malloc((r + 1) * sizeof *mn->binom);
+	mn->coef = malloc((r + 1) * sizeof *mn->coef);
+	mn->monos = calloc((r + 2) * w, sizeof *mn->monos);
+	if (!mn->pw || !mn->e || !mn->rem || !mn->binom || !mn->coef ||
+	    !mn->monos) {
+		free(mn->monos);
+		free(mn->coef);
+		free(mn->binom);
+		free(mn->rem);
+		free(mn->e);
+		free(mn->pw);
+		return false;
+	}
+
+	for (size_t i = 0; i < a->len; ++i) {
+		Coeff *pw = &mn->pw[i * (k + 1)];
+		pw[0] = (Coeff){ICOEFF_TERM, .hd.ival = 1};
+		for (long e = 1; e <= k; ++e) {
+			pw[e] = coeff_dup(&pw[e - 1]);
+			coeff_mul(&pw[e], &a->coeffs[i]);
+		}
+	}
+	for (int i = 0; i <= r; ++i) {
+		if (i < r) {
+			mn->binom[i] = (Coeff){ICOEFF_TERM, .hd.ival = 1};
+		}
+		mn->coef[i] = (Coeff){ICOEFF_TERM, .hd.ival = 1};
+	}
+	mn->top = &mn->monos[(r + 1) * w];
+	mn->rem[0] = k;
+	first_exps(mn, 0);
+	return true;
+}
+
+// Store the coefficient of the next term of the expansion to `*c` and its
+// monomial to `mn->top`. Return false if there are no terms left.
+static bool multinom_next(Multinom *mn, Coeff *c)
+{
+	int r = mn->r, w = mn->a->lay->nwords;
+	while (!mn->done) {
+		Coeff term = coeff_dup(&mn->coef[r]);
+		if (mn->has_const) {
+			coeff_mul(&term, &mn->pw[r * (mn->k + 1) + mn->rem[r]]);
+		}
+		memcpy(mn->top, &mn->monos[r * w], w * sizeof *mn->top);
+
+		// Move on to the next tuple of exponents.
+		int i = r - 1;
+		while (i >= 0 && !next_exp(mn, i)) {
+			--i;
+		}
+		if (i < 0) {
+			mn->done = true;
+		} else {
+			first_exps(mn, i + 1);
+		}
+
+		if (!coeff_zero(&term)) {
+			*c = term;
+			return true;
+		}
+		free_coeff(&term);
+	}
+	return false;
+}
+
+static void free_multinom(Multinom *mn)
+{
+	for (int i = 0; i <= mn->r; ++i) {
+		if (i < mn->r) {
+			free_coeff(&mn->binom[i]);
+		}
+		free_coeff(&mn->coef[i]);
+	}
+	for (size_t i = 0; i < mn->a->len * (mn->k + 1); ++i) {
+		free_coeff(&mn->pw[i]);
+	}
+	free(mn->monos);
+	free(mn->coef);
+	free(mn->binom);
+	free(mn->rem);
+	free(mn->e);
+	free(mn->pw);
+}
+
+// Expand `a^k` by the multinomial theorem. Every non-constant term of `a` must
+// be a power of a distinct variable.
+static void pow_multinom(PolyVec *dest, const PolyVec *a, long k)
+{
+	Multinom mn;
+	if (!multinom_init(&mn, a, k)) {
+		fprintf(stderr, "out of memory\n");
+		abort();
+	}
+	Coeff c;
+	while (multinom_next(&mn, &c)) {
+		vec_push(dest, &c, mn.top);
+	}
+	free_multinom(&mn);
+}
+
+// State of an expansion of `a^k` for a univariate `a` by J. C. P. Miller's
+// recurrence. With `a = x^s (a_0 + a_1 x + ... + a_n x^n)`, it is run on the
+// reversed coefficients `r_i = a_(n - i)`, so that the terms come out from the
+// highest power: `a^k = x^(sk) (c_0 x^nk + c_1 x^(nk - 1) + ... + c_nk)` for
+//   c_0 = r_0^k,
+//   c_m = 1 / (m r_0) * sum_{i = 1}^{min(n, m)} ((k + 1) i - m) r_i c_{m - i}.
+// Each coefficient costs at most `n` multiplications regardless of `k`, and
+// only the last `n` of them are kept.
+typedef struct Miller {
+	long n, s, k;
+	long m;	   // Index of the next coefficient
+	Coeff *rs; // `r_0` to `r_n`
+	Coeff *cs; // `c_m` is at `cs[m % (n + 1)]`.
+	uint64_t unit;
+	uint64_t top; // Monomial of the term produced last
+} Miller;
+
+// Initialize `ml` to expand `a^k`. Return false if there is not enough memory.
+static bool miller_init(Miller *ml, const PolyVec *a, long k)
+{
+	int w = a->lay->nwords; // A single word for a single variable.
+	uint64_t unit = (uint64_t)1 << (64 - a->lay->bits);
+	long s = a->monos[(a->len - 1) * w] / unit;
+	long n = a->monos[0] / unit - s;
+	*ml = (Miller){n, s, k, 0, malloc((n + 1) * sizeof *ml->rs),
+		       malloc((n + 1) * sizeof *ml->cs), unit, 0};
+	if (!ml->rs || !ml->cs) {
+		free(ml->cs);
+		free(ml->rs);
+		return false;
+	}
+	Coeff zero = {ICOEFF_TERM, .hd.ival = 0};
+	for (long i = 0; i <= n; ++i) {
+		ml->rs[i] = ml->cs[i] = zero;
+	}
+	for (size_t i = 0; i < a->len; ++i) {
+		long e = a->monos[i * w] / unit - s;
+		ml->rs[n - e] = coeff_dup(&a->coeffs[i]);
+	}
+	return true;
+}
+
+// Store the coefficient of the next term of the expansion to `*c` and its
+// monomial to `ml->top`. Return false if there are no terms left.
+static bool miller_next(Miller *ml, Coeff *c)
+{
+	long n = ml->n, k = ml->k;
+	for (; ml->m <= n * k; ++ml->m) {
+		long m = ml->m;
+		Coeff *cm = &ml->cs[m % (n + 1)];
+		free_coeff(cm);
+		if (!m) {
+			*cm = coeff_dup(&ml->rs[0]);
+			coeff_ipow(cm, k);
+		} else {
+			*cm = (Coeff){ICOEFF_TERM, .hd.ival = 0};
+			for (long i = 1; i <= n && i <= m; ++i) {
+				if (coeff_zero(&ml->rs[i])) {
+					continue;
+				}
+				Coeff t = {ICOEFF_TERM,
+					   .hd.ival = (k + 1) * i - m};
+				coeff_mul(&t, &ml->rs[i]);
+				coeff_mul(&t, &ml->cs[(m - i) % (n + 1)]);
+				coeff_add(cm, &t);
+				free_coeff(&t);
+			}
+			Coeff d = {ICOEFF_TERM, .hd.ival = m};
+			coeff_mul(&d, &ml->rs[0]);
+			coeff_div(cm, &d);
+			free_coeff(&d);
+		}
+		if (!coeff_zero(cm)) {
+			*c = coeff_dup(cm);
+			ml->top = (n * k - m + ml->s * k) * ml->unit;
+			++ml->m;
+			return true;
+		}
+	}
+	return false;
+}
+
+static void free_miller(Miller *ml)
+{
+	for (long i = 0; i <= ml->n; ++i) {
+		free_coeff(&ml->rs[i]);
+		free_coeff(&ml->cs[i]);
+	}
+	free(ml->cs);
+	free(ml->rs);
+}
+
+// Expand `a^k` for a univariate `a` by Miller's recurrence.
+static void pow_miller(PolyVec *dest, const PolyVec *a, long k)
+{
+	Miller ml;
+	if (!miller_init(&ml, a, k)) {
+		fprintf(stderr, "out of memory\n");
+		abort();
+	}
+	Coeff c;
+	while (miller_next(&ml, &c)) {
+		vec_push(dest, &c, &ml.top);
+	}
+	free_miller(&ml);
+}
+
+// Whether every non-constant term of `a` is a power of a distinct variable.
+static bool sum_of_powers(const PolyVec *a)
+{
+	int w = a->lay->nwords;
+	bool distinct = true;
+	uint64_t *seen = calloc(a->lay->nvars + 1, sizeof *seen);
+	for (size_t i = 0; i < a->len && distinct; ++i) {
+		int var = mono_var(a->lay, &a->monos[i * w]);
+		if (var == -2 || seen[var + 1]++) {
+			distinct = false;
+		}
+	}
+	free(seen);
+	return distinct;
+}
+
+// Whether `a^k` is better expanded by Miller's recurrence: `a` must be
+// univariate and dense, as the recurrence runs over every power up to the
+// degree of `a^k`, and exact, as it divides by the lowest coefficient.
+static bool miller(const PolyVec *a)
+{
+	if (a->lay->nvars != 1 || !exact(a)) {
+		return false;
+	}
+	uint64_t unit = (uint64_t)1 << (64 - a->lay->bits);
+	uint64_t span = (a->monos[0] - a->monos[a->len - 1]) / unit;
+	return 2 * a->len > span;
+}
+
+// Store a copy of `a` to `dest`.
+static void copy_vec(PolyVec *dest, const PolyVec *a)
+{
+	vec_init(dest, a->lay, a->len);
+	for (size_t i = 0; i < a->len; ++i) {
+		Coeff c = coeff_dup(&a->coeffs[i]);
+		vec_push(dest, &c, &a->monos[i * a->lay->nwords]);
+	}
+}
+
+// Store `a` raised to the power of `k`, a positive integer, to `dest`.
+// Sums of powers of distinct variables are expanded directly by the
+// multinomial theorem, and other dense univariate polynomials by Miller's
+// recurrence. Otherwise `a` is multiplied `k - 1` times by heap
+// multiplication, whose heap stays as small as `a`; for sparse polynomials
+// this does less work than repeated squaring, whose last product alone
+// compares every pair of terms of `a^(k/2)`.
+void vec_pow(PolyVec *dest, const PolyVec *a, long k)
+{
+	vec_init(dest, a->lay, 0);
+	if (!a->len) {
+		return;
+	}
+	if (sum_of_powers(a)) {
+		pow_multinom(dest, a, k);
+		return;
+	}
+	if (miller(a)) {
+		pow_miller(dest, a, k);
+		return;
+	}
+	if (k == 1) {
+		copy_vec(dest, a);
+		return;
+	}
+
+	PolyVec prod;
+	vec_mul(&prod, a, a);
+	for (long i = 2; i < k; ++i) {
+		free_vec(dest);
+		*dest = prod;
+		vec_mul(&prod, dest, a);
+	}
+	free_vec(dest);
+	*dest = prod;
+}
+
+// The terms of a `VecStream` come from the heap of `rows`, from the expansion
+// `mn` or `ml`, or from `vecs[0]`, already built.
+struct VecStream {
+	enum { ROWS_STREAM, MULTINOM_STREAM, MILLER_STREAM, VEC_STREAM } kind;
+	PolyVec vecs[2]; // Operands built for the stream
+	size_t pos;	 // Index of the next term of a `VEC_STREAM`
+	Rows rows;
+	Multinom mn;
+	Miller ml;
+};
+
+VecStream *vec_stream_mul(const PolyVec *a, const PolyVec *b)
+{
+	VecStream *s = calloc(1, sizeof *s);
+	s->kind = ROWS_STREAM;
+	rows_init(&s->rows, a, b);
+	return s;
+}
+
+VecStream *vec_stream_pow(const PolyVec *a, long k)
+{
+	VecStream *s = calloc(1, sizeof *s);
+	s->vecs[0].lay = s->vecs[1].lay = a->lay;
+	if (a->len && sum_of_powers(a)) {
+		s->kind = MULTINOM_STREAM;
+		if (!multinom_init(&s->mn, a, k)) {
+			free(s);
+			return NULL;
+		}
+	} else if (a->len && miller(a)) {
+		s->kind = MILLER_STREAM;
+		if (!miller_init(&s->ml, a, k)) {
+			free(s);
+			return NULL;
+		}
+	} else if (!a->len || k == 1 || !exact(a)) {
+		// Real coefficients would be summed in a different order.
+		s->kind = VEC_STREAM;
+		vec_pow(&s->vecs[0], a, k);
+	} else {
+		s->kind = ROWS_STREAM;
+		vec_pow(&s->vecs[0], a, k - k / 2);
+		if (k % 2) {
+			vec_pow(&s->vecs[1], a, k / 2);
+		}
+		rows_init(&s->rows, &s->vecs[0], &s->vecs[k % 2]);
+	}
+	return s;
+}
+
+bool vec_next(VecStream *s, Coeff *c, const uint64_t **m)
+{
+	switch (s->kind) {
+	case ROWS_STREAM:
+		*m = s->rows.top;
+		return rows_next(&s->rows, c);
+	case MULTINOM_STREAM:
+		*m = s->mn.top;
+		return multinom_next(&s->mn, c);
+	case MILLER_STREAM:
+		*m = &s->ml.top;
+		return miller_next(&s->ml, c);
+	case VEC_STREAM: {
+		PolyVec *v = &s->vecs[0];
+		if (s->pos == v->len) {
+			return false;
+		}
+		// The coefficient is moved out, leaving a zero behind.
+		*c = v->coeffs[s->pos];
+		v->coeffs[s->pos] = (Coeff){ICOEFF_TERM, .hd.ival = 0};
+		*m = &v->monos[s->pos++ * v->lay->nwords];
+		return true;
+	}
+	}
+	return false;
+}
+
+void free_stream(VecStream *s)
+{
+	switch (s->kind) {
+	case ROWS_STREAM:
+		free_rows(&s->rows);
+		break;
+	case MULTINOM_STREAM:
+		free_multinom(&s->mn);
+		break;
+	case MILLER_STREAM:
+		free_miller(&s->ml);
+		break;
+	case VEC_STREAM:
+		break;
+	}
+	free_vec(&s->vecs[1]);
+	free_vec(&s->vecs[0]);
+	free(s);
+}
+
+// Release the terms of `v`.
+void free_vec(PolyVec *v)
+{
+	for (size_t i = 0; i < v->len; ++i) {
+		free_coeff(&v->coeffs[i]);
+	}
+	free(v->coeffs);
+	free(v->monos);
+	*v = (PolyVec){0, 0, NULL, NULL, v->lay};
+}
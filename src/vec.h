@@ -0,0 +1,90 @@
+#ifndef VEC_H
+#define VEC_H
+
+#include "mono.h"
+#include "term.h"
+#include <stddef.h>
+#include <stdint.h>
+
+// A polynomial stored as a sorted vector of terms: `coeffs[i]`, owned by the
+// vector, is the coefficient of the monomial packed at
+// `&monos[i * lay->nwords]`. Terms are sorted in the descending order of
+// monomials as in a `TermNode` list, and no coefficient is zero, i.e., the zero
+// polynomial is the empty vector.
+//
+// Unlike `TermNode` lists, the terms are contiguous in memory; large products
+// are built in `PolyVec`s and only converted to a list once done.
+typedef struct PolyVec {
+	size_t len, cap;
+	Coeff *coeffs;
+	uint64_t *monos;
+	const MonoLayout *lay; // Not owned by the vector.
+} PolyVec;
+
+// Initialize `v` as an empty vector with room for `cap` terms.
+void vec_init(PolyVec *v, const MonoLayout *lay, size_t cap);
+
+// Initialize `v` with the terms of `p`. `lay` must cover every variable and
+// exponent of `p`.
+void vec_from_poly(PolyVec *v, const MonoLayout *lay, const TermNode *p);
+
+// Return a polynomial with the terms of `v`, leaving `v` empty.
+TermNode *vec_to_poly(PolyVec *v);
+
+// Append a term to `v`, taking over the value of `c`. The term must precede
+// every term already in `v`.
+void vec_push(PolyVec *v, const Coeff *c, const uint64_t *m);
+
+// Store the sum of `a` and `b` to `dest`, which must not alias either.
+// The terms are merged into a buffer sized for both, and terms cancelling out
+// are dropped while merging.
+void vec_add(PolyVec *dest, const PolyVec *a, const PolyVec *b);
+
+// Store the product of `a` and a single term to `dest`, which must not alias
+// `a`. Multiplying by a monomial preserves the order of the terms.
+void vec_mul_term(PolyVec *dest, const PolyVec *a, const Coeff *c,
+		  const uint64_t *m);
+
+// The number of threads `vec_mul` may use when called from the current thread,
+// 1 by default.
+extern _Thread_local int vec_threads;
+
+// Store the product of `a` and `b` to `dest`, which must not alias either.
+// The product is built in sorted order by a heap over the rows of `b`, split
+// into blocks of rows across `vec_threads` threads if large enough.
+void vec_mul(PolyVec *dest, const PolyVec *a, const PolyVec *b);
+
+// Store `a` raised to the power of `k`, a positive integer, to `dest`.
+// The fields of the layout must be wide enough to hold the resulting exponents.
+void vec_pow(PolyVec *dest, const PolyVec *a, long k);
+
+// A stream produces the terms of a product or a power one at a time, in the
+// order of a `PolyVec`, so that they can be consumed without building the
+// whole result. The operands must outlive the stream.
+typedef struct VecStream VecStream;
+
+// Return a stream of the product of `a` and `b`, merged from a row per term of
+// `b` as by `vec_mul` on a single thread.
+VecStream *vec_stream_mul(const PolyVec *a, const PolyVec *b);
+
+// Return a stream of `a` raised to the power of `k`, a positive integer, or
+// `NULL` if there is not enough memory for it.
+// Sums of powers of distinct variables are expanded a term at a time, keeping
+// the powers of their coefficients up to `k`, and dense univariate polynomials
+// with exact coefficients as well, keeping as many coefficients as `a` has.
+// Other polynomials with exact coefficients are streamed as the product of two
+// powers of about `k / 2`, which are built. Otherwise the power is built as by
+// `vec_pow`, and then streamed.
+VecStream *vec_stream_pow(const PolyVec *a, long k);
+
+// Store the next term of `s` to `*c`, which takes over its value, and `*m`,
+// which is valid until the next call. Return false if there are no terms left.
+bool vec_next(VecStream *s, Coeff *c, const uint64_t **m);
+
+// Release `s`.
+void free_stream(VecStream *s);
+
+// Release the terms of `v`.
+void free_vec(PolyVec *v);
+
+#endif /* ifndef VEC_H */
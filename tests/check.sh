@@ -0,0 +1,63 @@
+#!/bin/sh
+# Usage: tests/check.sh ./build/poly
+#
+# Run PolyCalc on the inputs under `tests` and compare its output with the
+# expected one. Every input under `tests/golden` must give the same output with
+# any combination of the flags below, as the flags only change how a result is
+# computed. The environment round trip, the evaluation of tables, and the
+# generated C functions, compiled with `$CC`, are checked as well.
+
+poly=$1
+dir=$(dirname "$0")
+cc=${CC:-cc}
+tmp=$(mktemp -d)
+trap 'rm -rf "$tmp"' EXIT
+passed=0
+failed=0
+
+# Compare the output `$2` of the test `$1` with the expected output `$3`.
+check() {
+	if cmp -s "$3" "$2"; then
+		passed=$((passed + 1))
+	else
+		failed=$((failed + 1))
+		echo "FAIL: $1"
+		diff "$3" "$2" | head -n 20
+	fi
+}
+
+for input in "$dir"/golden/*.poly; do
+	name=$(basename "$input" .poly)
+	for flags in "" "-b" "-t" "-c 1" "-c 64" "-j 4" "-b -n 3 -j 4" \
+	    "-t -j 4" "-c 64 -t"; do
+		"$poly" $flags "$input" >"$tmp/out" 2>/dev/null
+		check "$name $flags" "$tmp/out" "$dir/golden/$name.out"
+	done
+done
+
+# Variables saved by `-w` are loaded by `-l` as if they had been assigned.
+"$poly" -q -w "$tmp/env.bin" "$dir/env_def.poly" >/dev/null 2>&1
+for flags in "" "-b" "-c 64"; do
+	"$poly" $flags -l "$tmp/env.bin" "$dir/env_use.poly" >"$tmp/out" \
+	    2>/dev/null
+	check "env $flags" "$tmp/out" "$dir/env_use.out"
+done
+
+for flags in "" "-b" "-t"; do
+	"$poly" -q $flags -e "$dir/table.csv" "$dir/table.poly" \
+	    >"$tmp/out" 2>/dev/null
+	check "table $flags" "$tmp/out" "$dir/table.out"
+done
+
+"$poly" -q -g "$dir/gen.poly" >"$tmp/gen.c" 2>/dev/null
+check "gen" "$tmp/gen.c" "$dir/gen.out"
+if "$cc" -o "$tmp/gen" "$dir/gen_main.c" "$tmp/gen.c"; then
+	"$tmp/gen" >"$tmp/out"
+	check "gen values" "$tmp/out" "$dir/gen_values.out"
+else
+	failed=$((failed + 1))
+	echo "FAIL: gen does not compile"
+fi
+
+echo "$passed passed, $failed failed"
+[ "$failed" -eq 0 ]
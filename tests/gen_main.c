@@ -0,0 +1,20 @@
+// Print the values of the functions generated from `gen.poly` at a few points.
+#include <stdio.h>
+
+double poly1(double x, double y);
+double poly2(double x);
+double poly3(double vif, double vint);
+double poly4(double x, double y, double z);
+double poly5(void);
+
+int main(void)
+{
+	static const double pts[][3] = {
+	    {1, 2, 3}, {0.5, -1, 2}, {-2, 0.25, -1}, {3, 4, 0}};
+	for (size_t i = 0; i < sizeof pts / sizeof *pts; ++i) {
+		double x = pts[i][0], y = pts[i][1], z = pts[i][2];
+		printf("%.12g %.12g %.12g %.12g %.12g\n", poly1(x, y),
+		       poly2(x), poly3(x, y), poly4(x, y, z), poly5());
+	}
+	return 0;
+}